@@ -25,10 +25,60 @@
  * needed (e, e-1 and e-2), therefore we use clock arithmetics.
  *
  * See the comments in the ebr_sync() function for detailed explanation.
+ *
+ * Asymmetric barriers:
+ *
+ * On Linux, the EBR_MEMBARRIER flag can be used to move the cost of the
+ * memory barriers from the readers to the synchronising side: enter/exit
+ * issue only the compiler barriers, while ebr_sync() issues the
+ * membarrier(2) system call, which executes a memory barrier on all
+ * running threads of the process.  This is a good trade-off if the
+ * readers are frequent and the synchronisation is relatively rare.
+ *
+ * Hierarchical mode:
+ *
+ * With a large number of threads, ebr_sync() has to inspect a cache line
+ * of every registered thread, many of them residing on the remote NUMA
+ * nodes.  The EBR_HIERARCHICAL flag enables aggregation: the threads are
+ * assigned to the groups (based on the NUMA node and the CPU at the time
+ * of registration) and each group has a counter of the active workers
+ * in each epoch.  The readers atomically increment and decrement these
+ * counters, while ebr_sync() only has to check that the counters of the
+ * other epochs are zero in all the groups.  This trades the cost of an
+ * atomic operation on a (mostly) node-local cache line on the reader side
+ * for a much cheaper synchronisation.
+ *
+ * Stalled workers:
+ *
+ * A worker staying in the critical path holds back the epoch and hence
+ * the reclamation.  To find such workers, without adding any cost to the
+ * reader path, the synchronising side records the time when it observes
+ * a worker holding back the epoch, together with the epoch generation
+ * (the number of the epochs announced).  The worker which keeps holding
+ * back the same generation is in the same critical path, since it would
+ * observe the current epoch on re-entering.  See ebr_laggards() and the
+ * watchdog, ebr_set_watchdog().
+ *
+ * Waiting:
+ *
+ * Instead of polling, a synchroniser may block using ebr_wait() until a
+ * worker holding back the epoch leaves the critical path.  The waiter
+ * publishes its presence and the worker leaving the critical path of a
+ * previous epoch wakes it up (using futex(2) on Linux).  The readers only
+ * compare their epoch with the global one, which they read on entry
+ * anyway, so they pay nothing extra unless the epoch has moved on while
+ * they were in the critical path.  Only then, in ebr_wakeup(), they issue
+ * a full barrier (unless the mode already provides one) and check for the
+ * waiters.  The waiter also re-checks the workers at a short interval
+ * (EBR_WAIT_SLICE), which bounds the cost of a wakeup missed for any other
+ * reason, e.g. a worker leaving the critical path just as the epoch moves.
+ *
+ * The reader fast paths are also provided as the inline functions, see
+ * ebr_inline.h, which relies on the layout of the leading members.
  */
 
-#include <sys/queue.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
 #include <time.h>
@@ -36,34 +86,255 @@
 #include <pthread.h>
 #include <sched.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <unistd.h>
+#endif
+
 #include "ebr.h"
+#include "ebr_inline.h"
 #include "utils.h"
 
-#define	ACTIVE_FLAG		(0x80000000U)
+#define	ACTIVE_FLAG		EBR_ACTIVE_FLAG
 
-typedef struct ebr_tls {
+struct ebr_tls {
 	/*
 	 * - A local epoch counter for each thread.
 	 * - The epoch counter may have the "active" flag set.
-	 * - Thread list entry (pointer).
+	 * - Whether the slot is used (claimed by a thread).
 	 */
 	unsigned		local_epoch;
-	LIST_ENTRY(ebr_tls)	entry;
-} ebr_tls_t;
+	unsigned		used;
+
+	/*
+	 * The group of the thread (in the hierarchical mode).
+	 */
+	unsigned		group;
+
+	/*
+	 * The stall: the epoch generation (plus one) the worker was first
+	 * observed holding back, the time of that and whether the watchdog
+	 * fired.
+	 * Written by the synchronising side.  Also, the label.
+	 */
+	uint64_t		stall_gen;
+	uint64_t		stall_time;
+	unsigned		stall_reported;
+	char			label[EBR_LABEL_LEN];
+} __aligned(CACHE_LINE_SIZE);
+
+/*
+ * The registered threads occupy the slots in a growable array, which
+ * consists of chunks: the first chunk has EBR_CHUNK_SLOTS slots and each
+ * next chunk is twice the size of the previous one.  The chunks are only
+ * freed when the EBR object is destroyed, therefore the slots can be
+ * claimed and released using the atomic operations, while the scan on
+ * ebr_sync() is a lock-less linear sweep.
+ */
+#define	EBR_CHUNK_SLOTS		16
+#define	EBR_MAX_CHUNKS		24
+
+/*
+ * The groups of the hierarchical mode: the number of groups per NUMA node
+ * (the threads are spread across them by the CPU) and the total limit.
+ */
+#define	EBR_NODE_GROUPS		4
+#define	EBR_MAX_GROUPS		32
+
+/*
+ * The interval (in milliseconds) at which ebr_wait() re-checks the
+ * workers, should a wakeup be missed.
+ */
+#define	EBR_WAIT_SLICE		1
+
+typedef struct {
+	unsigned		active[EBR_EPOCHS];
+} __aligned(CACHE_LINE_SIZE) ebr_group_t;
 
 struct ebr {
 	/*
 	 * - There is a global epoch counter which can be 0, 1 or 2.
-	 * - TLS with a list of the registered threads.
+	 * - Flags, read on every enter/exit, and the number of waiters,
+	 *   read on leaving the critical path of a previous epoch; keep
+	 *   them on the same line.
+	 * - TLS and the slot array of the registered threads.
 	 */
 	unsigned		global_epoch;
+	unsigned		flags;
+	unsigned		waiters;
 	pthread_key_t		tls_key;
-	pthread_mutex_t		lock;
-	LIST_HEAD(, ebr_tls)	list;
+	unsigned		nchunks;
+	ebr_tls_t *		chunks[EBR_MAX_CHUNKS];
+
+	/*
+	 * The groups (in the hierarchical mode) and the mask of the
+	 * groups which have been assigned any threads.
+	 */
+	ebr_group_t *		groups;
+	uint32_t		group_mask;
+
+	/*
+	 * The flag of the synchronisation in progress (it serialises the
+	 * concurrent ebr_sync() calls) and the statistics: the number of
+	 * successful (i.e. new epoch announced) and failed attempts.  Keep
+	 * these on a separate cache line, since the readers access the
+	 * global epoch.
+	 */
+	unsigned		sync_busy __aligned(CACHE_LINE_SIZE);
+	uint64_t		sync_ok;
+	uint64_t		sync_fail;
+
+	/*
+	 * The wakeup sequence number, used as the futex word.
+	 */
+	unsigned		wait_seq;
+
+	/*
+	 * The watchdog: the callback, its argument and the threshold.
+	 */
+	ebr_watchdog_t		watchdog;
+	void *			watchdog_arg;
+	uint64_t		watchdog_nsec;
 };
 
+/*
+ * The layout published to the inline fast paths.
+ */
+_Static_assert(offsetof(struct ebr, global_epoch) ==
+    offsetof(ebr_pub_t, global_epoch), "ebr_pub_t::global_epoch");
+_Static_assert(offsetof(struct ebr, flags) ==
+    offsetof(ebr_pub_t, flags), "ebr_pub_t::flags");
+_Static_assert(offsetof(struct ebr_tls, local_epoch) ==
+    offsetof(ebr_tls_pub_t, local_epoch), "ebr_tls_pub_t::local_epoch");
+
+#if defined(__linux__) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+
+static int
+membarrier(int cmd)
+{
+	return syscall(__NR_membarrier, cmd, 0);
+}
+
+/*
+ * ebr_membarrier_init: check whether the expedited private membarrier(2)
+ * is supported and register the process for its use.
+ */
+static bool
+ebr_membarrier_init(void)
+{
+	const int cmd = MEMBARRIER_CMD_PRIVATE_EXPEDITED;
+	int ret;
+
+	ret = membarrier(MEMBARRIER_CMD_QUERY);
+	if (ret == -1 || (ret & cmd) == 0) {
+		return false;
+	}
+	return membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+}
+
+static void
+ebr_membarrier(void)
+{
+	int ret;
+
+	ret = membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+	ASSERT(ret == 0); (void)ret;
+}
+
+#else
+
+static bool
+ebr_membarrier_init(void)
+{
+	return false;
+}
+
+static void
+ebr_membarrier(void)
+{
+	/* Not reached. */
+	abort();
+}
+
+#endif
+
+#if defined(__linux__) && defined(SYS_futex)
+
+static void
+ebr_futex_wait(unsigned *addr, unsigned val, unsigned msec)
+{
+	const struct timespec ts = {
+		msec / 1000, (msec % 1000) * 1000 * 1000
+	};
+	(void)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+}
+
+static void
+ebr_futex_wake(unsigned *addr)
+{
+	(void)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX,
+	    NULL, NULL, 0);
+}
+
+#else
+
+static void
+ebr_futex_wait(unsigned *addr, unsigned val, unsigned msec)
+{
+	const struct timespec ts = {
+		msec / 1000, (msec % 1000) * 1000 * 1000
+	};
+	(void)addr; (void)val;
+	(void)nanosleep(&ts, NULL);
+}
+
+static void
+ebr_futex_wake(unsigned *addr)
+{
+	(void)addr;
+}
+
+#endif
+
+/*
+ * ebr_reader_fence: the memory barrier on the reader side.  In the
+ * asymmetric mode, it is paired with ebr_membarrier() in ebr_sync().
+ */
+static inline void
+ebr_reader_fence(const ebr_t *ebr)
+{
+	if (ebr->flags & EBR_MEMBARRIER) {
+		atomic_signal_fence(memory_order_seq_cst);
+		return;
+	}
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*
+ * ebr_slot_release: release the slot; also used as the TLS destructor.
+ */
+static void
+ebr_slot_release(void *arg)
+{
+	ebr_tls_t *t = arg;
+
+	ASSERT((t->local_epoch & ACTIVE_FLAG) == 0);
+	atomic_store_explicit(&t->local_epoch, 0, memory_order_relaxed);
+	memset(t->label, 0, sizeof(t->label));
+	atomic_store_explicit(&t->used, 0, memory_order_release);
+}
+
+/*
+ * ebr_create_ex: construct a new EBR object.
+ *
+ * => If EBR_MEMBARRIER is requested, but membarrier(2) is not available,
+ *    then fall back to the regular memory barriers.
+ */
 ebr_t *
-ebr_create(void)
+ebr_create_ex(unsigned flags)
 {
 	ebr_t *ebr;
 	int ret;
@@ -74,50 +345,165 @@ ebr_create(void)
 		return NULL;
 	}
 	memset(ebr, 0, sizeof(ebr_t));
-	if (pthread_key_create(&ebr->tls_key, free) != 0) {
+	if (pthread_key_create(&ebr->tls_key, ebr_slot_release) != 0) {
 		free(ebr);
 		return NULL;
 	}
-	pthread_mutex_init(&ebr->lock, NULL);
+
+	if (flags & EBR_HIERARCHICAL) {
+		const size_t len = EBR_MAX_GROUPS * sizeof(ebr_group_t);
+
+		ret = posix_memalign((void **)&ebr->groups,
+		    CACHE_LINE_SIZE, len);
+		if (ret != 0) {
+			pthread_key_delete(ebr->tls_key);
+			free(ebr);
+			errno = ret;
+			return NULL;
+		}
+		memset(ebr->groups, 0, len);
+
+		/* The readers use the atomic operations anyway. */
+		flags &= ~EBR_MEMBARRIER;
+	}
+	if ((flags & EBR_MEMBARRIER) && !ebr_membarrier_init()) {
+		flags &= ~EBR_MEMBARRIER;
+	}
+	ebr->flags = flags;
 	return ebr;
 }
 
+ebr_t *
+ebr_create(void)
+{
+	return ebr_create_ex(0);
+}
+
 void
 ebr_destroy(ebr_t *ebr)
 {
 	pthread_key_delete(ebr->tls_key);
-	pthread_mutex_destroy(&ebr->lock);
+	for (unsigned i = 0; i < ebr->nchunks; i++) {
+		free(ebr->chunks[i]);
+	}
+	free(ebr->groups);
 	free(ebr);
 }
 
 /*
- * ebr_register: register the current worker (thread/process) for EBR.
+ * ebr_group_select: select the group for the current thread, based on
+ * the NUMA node and the CPU it is running on.
+ */
+static unsigned
+ebr_group_select(ebr_t *ebr)
+{
+	unsigned cpu = 0, node = 0, group;
+
+#if defined(__linux__) && defined(SYS_getcpu)
+	(void)syscall(SYS_getcpu, &cpu, &node, NULL);
+#endif
+	group = (node * EBR_NODE_GROUPS + cpu % EBR_NODE_GROUPS);
+	group %= EBR_MAX_GROUPS;
+
+	atomic_fetch_or(&ebr->group_mask, 1U << group);
+	return group;
+}
+
+/*
+ * ebr_slot_claim: find a free slot and claim it; if there are none,
+ * then add a new chunk.
+ */
+static ebr_tls_t *
+ebr_slot_claim(ebr_t *ebr)
+{
+	unsigned nchunks;
+	ebr_tls_t *chunk;
+	size_t len;
+	int ret;
+again:
+	nchunks = atomic_load_explicit(&ebr->nchunks, memory_order_acquire);
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = EBR_CHUNK_SLOTS << i;
+
+		chunk = ebr->chunks[i];
+		for (unsigned j = 0; j < nslots; j++) {
+			ebr_tls_t *t = &chunk[j];
+
+			if (!t->used &&
+			    atomic_compare_exchange_weak(&t->used, 0, 1)) {
+				return t;
+			}
+		}
+	}
+	if (nchunks == EBR_MAX_CHUNKS) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	/*
+	 * Add a new chunk.  If we race with another thread and lose,
+	 * then just help it to publish the new chunk count.
+	 */
+	len = (EBR_CHUNK_SLOTS << nchunks) * sizeof(ebr_tls_t);
+	ret = posix_memalign((void **)&chunk, CACHE_LINE_SIZE, len);
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(chunk, 0, len);
+	if (!atomic_compare_exchange_weak(&ebr->chunks[nchunks], NULL, chunk)) {
+		free(chunk);
+	}
+	atomic_compare_exchange_weak(&ebr->nchunks, nchunks, nchunks + 1);
+	goto again;
+}
+
+/*
+ * ebr_register_h: register the current worker (thread/process) for EBR
+ * and return its handle, which can be passed to the *_h() routines in
+ * order to avoid the TLS lookup on every call.
  *
- * => Returns 0 on success and errno on failure.
+ * => Returns NULL on failure (errno is set).
  */
-int
-ebr_register(ebr_t *ebr)
+ebr_tls_t *
+ebr_register_h(ebr_t *ebr)
 {
 	ebr_tls_t *t;
 
 	t = pthread_getspecific(ebr->tls_key);
 	if (__predict_false(t == NULL)) {
-		int ret;
-
-		ret = posix_memalign((void **)&t,
-		    CACHE_LINE_SIZE, sizeof(ebr_tls_t));
-		if (ret != 0) {
-			errno = ret;
-			return -1;
+		if ((t = ebr_slot_claim(ebr)) == NULL) {
+			return NULL;
+		}
+		/* The stall of the previous owner is not ours. */
+		t->stall_gen = t->stall_time = 0;
+		t->stall_reported = 0;
+		if (ebr->flags & EBR_HIERARCHICAL) {
+			t->group = ebr_group_select(ebr);
 		}
 		pthread_setspecific(ebr->tls_key, t);
 	}
-	memset(t, 0, sizeof(ebr_tls_t));
+	return t;
+}
+
+/*
+ * ebr_register: register the current worker (thread/process) for EBR.
+ *
+ * => Returns 0 on success and errno on failure.
+ */
+int
+ebr_register(ebr_t *ebr)
+{
+	return ebr_register_h(ebr) ? 0 : -1;
+}
 
-	pthread_mutex_lock(&ebr->lock);
-	LIST_INSERT_HEAD(&ebr->list, t, entry);
-	pthread_mutex_unlock(&ebr->lock);
-	return 0;
+/*
+ * ebr_registered_p: return true if the current thread is registered.
+ */
+bool
+ebr_registered_p(ebr_t *ebr)
+{
+	return pthread_getspecific(ebr->tls_key) != NULL;
 }
 
 void
@@ -130,23 +516,18 @@ ebr_unregister(ebr_t *ebr)
 		return;
 	}
 	pthread_setspecific(ebr->tls_key, NULL);
-
-	pthread_mutex_lock(&ebr->lock);
-	LIST_REMOVE(t, entry);
-	pthread_mutex_unlock(&ebr->lock);
-	free(t);
+	ebr_slot_release(t);
 }
 
 /*
- * ebr_enter: mark the entrance to the critical path.
+ * ebr_enter_h: mark the entrance to the critical path, given the
+ * handle of the current worker.
  */
 void
-ebr_enter(ebr_t *ebr)
+ebr_enter_h(ebr_t *ebr, ebr_tls_t *t)
 {
-	ebr_tls_t *t;
 	unsigned epoch;
 
-	t = pthread_getspecific(ebr->tls_key);
 	ASSERT(t != NULL);
 
 	/*
@@ -154,20 +535,26 @@ ebr_enter(ebr_t *ebr)
 	 * epoch (i.e. observe the global epoch).  Ensure that the
 	 * epoch is observed before any loads in the critical path.
 	 */
-	epoch = ebr->global_epoch | ACTIVE_FLAG;
-	atomic_store_explicit(&t->local_epoch, epoch, memory_order_relaxed);
-	atomic_thread_fence(memory_order_seq_cst);
+	epoch = ebr->global_epoch;
+	atomic_store_explicit(&t->local_epoch,
+	    epoch | ACTIVE_FLAG, memory_order_relaxed);
+	if (ebr->flags & EBR_HIERARCHICAL) {
+		/* Note: the atomic operation is a full barrier. */
+		atomic_fetch_add(&ebr->groups[t->group].active[epoch], 1);
+		return;
+	}
+	ebr_reader_fence(ebr);
 }
 
 /*
- * ebr_exit: mark the exit of the critical path.
+ * ebr_exit_h: mark the exit of the critical path, given the handle
+ * of the current worker.
  */
 void
-ebr_exit(ebr_t *ebr)
+ebr_exit_h(ebr_t *ebr, ebr_tls_t *t)
 {
-	ebr_tls_t *t;
+	unsigned epoch;
 
-	t = pthread_getspecific(ebr->tls_key);
 	ASSERT(t != NULL);
 
 	/*
@@ -175,22 +562,275 @@ ebr_exit(ebr_t *ebr)
 	 * the critical path reach global visibility before that.
 	 */
 	ASSERT(t->local_epoch & ACTIVE_FLAG);
-	atomic_thread_fence(memory_order_seq_cst);
+	epoch = t->local_epoch & ~ACTIVE_FLAG;
+	if (ebr->flags & EBR_HIERARCHICAL) {
+		atomic_fetch_add(&ebr->groups[t->group].active[epoch], -1);
+	} else {
+		ebr_reader_fence(ebr);
+	}
 	atomic_store_explicit(&t->local_epoch, 0, memory_order_relaxed);
+
+	/*
+	 * If we were holding back the epoch, then someone may be
+	 * waiting for us: take the slow path.
+	 */
+	if (__predict_false(epoch != ebr->global_epoch)) {
+		ebr_wakeup(ebr);
+	}
+}
+
+/*
+ * ebr_wakeup: wake up the waiters in ebr_wait(), if any; the slow path
+ * of leaving the critical path of a previous epoch.
+ */
+void
+ebr_wakeup(ebr_t *ebr)
+{
+	/*
+	 * The check of the waiters must be ordered after clearing the
+	 * local epoch, pairing with the increment in ebr_wait(): either
+	 * the waiter observes us leaving or we observe the waiter.  In
+	 * the hierarchical mode, the atomic decrement is a full barrier;
+	 * in the membarrier mode, the waiter issues the barrier for us.
+	 */
+	if ((ebr->flags & (EBR_MEMBARRIER | EBR_HIERARCHICAL)) == 0) {
+		atomic_thread_fence(memory_order_seq_cst);
+	}
+	if (atomic_load_explicit(&ebr->waiters, memory_order_relaxed) == 0) {
+		return;
+	}
+	atomic_fetch_add(&ebr->wait_seq, 1);
+	ebr_futex_wake(&ebr->wait_seq);
+}
+
+/*
+ * ebr_enter: mark the entrance to the critical path.
+ */
+void
+ebr_enter(ebr_t *ebr)
+{
+	ebr_enter_h(ebr, pthread_getspecific(ebr->tls_key));
+}
+
+/*
+ * ebr_exit: mark the exit of the critical path.
+ */
+void
+ebr_exit(ebr_t *ebr)
+{
+	ebr_exit_h(ebr, pthread_getspecific(ebr->tls_key));
+}
+
+/*
+ * ebr_observed_p: return true if all active workers observed the given
+ * epoch, i.e. there are no workers in the critical path which entered
+ * it in the other epochs.
+ *
+ * => Otherwise, return the worker holding back the epoch, if known.
+ */
+static bool
+ebr_observed_p(ebr_t *ebr, unsigned epoch, ebr_tls_t **laggard)
+{
+	unsigned nchunks;
+
+	if (ebr->flags & EBR_HIERARCHICAL) {
+		const unsigned e1 = (epoch + 1) % EBR_EPOCHS;
+		const unsigned e2 = (epoch + 2) % EBR_EPOCHS;
+		uint32_t mask = ebr->group_mask;
+
+		while (mask) {
+			const unsigned i = __builtin_ctz(mask);
+			const ebr_group_t *grp = &ebr->groups[i];
+
+			if (atomic_load_explicit(&grp->active[e1],
+			    memory_order_relaxed) ||
+			    atomic_load_explicit(&grp->active[e2],
+			    memory_order_relaxed)) {
+				return false;
+			}
+			mask &= mask - 1;
+		}
+		return true;
+	}
+
+	nchunks = atomic_load_explicit(&ebr->nchunks, memory_order_acquire);
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = EBR_CHUNK_SLOTS << i;
+		ebr_tls_t *chunk = ebr->chunks[i];
+
+		for (unsigned j = 0; j < nslots; j++) {
+			unsigned local_epoch;
+			bool active;
+
+			local_epoch = atomic_load_explicit(
+			    &chunk[j].local_epoch, memory_order_relaxed);
+			active = (local_epoch & ACTIVE_FLAG) != 0;
+
+			if (active && (local_epoch != (epoch | ACTIVE_FLAG))) {
+				*laggard = &chunk[j];
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * ebr_stall_note: record the stall of the worker holding back the
+ * epoch of the given generation, unless already recorded.
+ *
+ * => Returns the time when the stall was first observed.
+ */
+static uint64_t
+ebr_stall_note(ebr_tls_t *t, uint64_t gen, uint64_t *now)
+{
+	/* Note: zero means no stall recorded. */
+	gen++;
+
+	if (atomic_load_explicit(&t->stall_gen, memory_order_relaxed) != gen) {
+		if (*now == 0) {
+			*now = clock_nsec();
+		}
+		atomic_store_explicit(&t->stall_time, *now,
+		    memory_order_relaxed);
+		atomic_store_explicit(&t->stall_reported, 0,
+		    memory_order_relaxed);
+		atomic_store_explicit(&t->stall_gen, gen,
+		    memory_order_relaxed);
+	}
+	return atomic_load_explicit(&t->stall_time, memory_order_relaxed);
+}
+
+/*
+ * ebr_laggards_scan: find the workers holding back the epoch, record
+ * their stalls and fill in up to the given number of the entries.  If
+ * requested, fire the watchdog for the stalls exceeding the threshold.
+ *
+ * => Returns the number of the workers holding back the epoch.
+ */
+static unsigned
+ebr_laggards_scan(ebr_t *ebr, ebr_laggard_t *lags, unsigned max, bool fire)
+{
+	const uint64_t gen =
+	    atomic_load_explicit(&ebr->sync_ok, memory_order_acquire);
+	const unsigned epoch = ebr->global_epoch | ACTIVE_FLAG;
+	const unsigned nchunks =
+	    atomic_load_explicit(&ebr->nchunks, memory_order_acquire);
+	unsigned count = 0;
+	uint64_t now = 0;
+
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = EBR_CHUNK_SLOTS << i;
+		ebr_tls_t *chunk = ebr->chunks[i];
+
+		for (unsigned j = 0; j < nslots; j++) {
+			ebr_tls_t *t = &chunk[j];
+			ebr_laggard_t lag;
+			unsigned local_epoch;
+
+			local_epoch = atomic_load_explicit(&t->local_epoch,
+			    memory_order_relaxed);
+			if ((local_epoch & ACTIVE_FLAG) == 0 ||
+			    local_epoch == epoch) {
+				continue;
+			}
+			if (now == 0) {
+				now = clock_nsec();
+			}
+			lag.stall_nsec = ebr_stall_note(t, gen, &now);
+			lag.stall_nsec = now > lag.stall_nsec ?
+			    now - lag.stall_nsec : 0;
+			memcpy(lag.label, t->label, EBR_LABEL_LEN);
+			lag.label[EBR_LABEL_LEN - 1] = '\0';
+
+			if (count < max) {
+				lags[count] = lag;
+			}
+			count++;
+
+			if (fire && lag.stall_nsec >= ebr->watchdog_nsec &&
+			    !t->stall_reported) {
+				t->stall_reported = 1;
+				ebr->watchdog(&lag, ebr->watchdog_arg);
+			}
+		}
+	}
+	return count;
+}
+
+/*
+ * ebr_laggards: get the workers which are holding back the epoch, i.e.
+ * are in the critical path which they entered in a previous epoch.  The
+ * stall time is measured from the moment the worker was first observed
+ * holding back the epoch (by ebr_sync() or this function), therefore it
+ * is a lower bound.
+ *
+ * => Fills in up to the given number of the entries.
+ * => Returns the number of the workers holding back the epoch.
+ */
+unsigned
+ebr_laggards(ebr_t *ebr, ebr_laggard_t *lags, unsigned max)
+{
+	return ebr_laggards_scan(ebr, lags, max, false);
+}
+
+/*
+ * ebr_set_label: set the label of the current worker, which identifies
+ * it in the laggard reports.  The label is truncated, if too long.
+ */
+void
+ebr_set_label(ebr_t *ebr, const char *label)
+{
+	ebr_tls_t *t = pthread_getspecific(ebr->tls_key);
+
+	ASSERT(t != NULL);
+	strncpy(t->label, label, EBR_LABEL_LEN - 1);
+	t->label[EBR_LABEL_LEN - 1] = '\0';
+}
+
+/*
+ * ebr_set_watchdog: set the callback, which is called (by ebr_sync(), at
+ * most once per stall) when a worker holds back the epoch for longer than
+ * the threshold.  Must be set before the synchronisation is performed.
+ * NULL function disables the watchdog.
+ *
+ * => Note: the watchdog adds a sweep of all slots on every unsuccessful
+ *    synchronisation attempt, also in the hierarchical mode.
+ */
+void
+ebr_set_watchdog(ebr_t *ebr, unsigned msec, ebr_watchdog_t fn, void *arg)
+{
+	ebr->watchdog_nsec = (uint64_t)msec * 1000000;
+	ebr->watchdog_arg = arg;
+	ebr->watchdog = fn;
 }
 
 /*
  * ebr_sync: attempt to synchronise and announce a new epoch.
  *
- * => Synchronisation points must be serialised.
+ * => May be called concurrently: if another thread is synchronising,
+ *    then return false immediately (it would announce the epoch).
  * => Return true if a new epoch was announced.
  * => Return the epoch ready for reclamation.
  */
 bool
 ebr_sync(ebr_t *ebr, unsigned *gc_epoch)
 {
+	ebr_tls_t *laggard = NULL;
 	unsigned epoch;
-	ebr_tls_t *t;
+
+	/*
+	 * Only one thread may advance the epoch at a time.  Note: just
+	 * comparing-and-swapping the epoch would be prone to the ABA
+	 * problem, since the epoch could wrap around meanwhile.  Losing
+	 * the race is not a failed synchronisation, so it is not counted
+	 * (which would also contend on the counter).
+	 */
+	if (ebr->sync_busy ||
+	    !atomic_compare_exchange_weak(&ebr->sync_busy, 0, 1)) {
+		*gc_epoch = ebr_gc_epoch(ebr);
+		return false;
+	}
 
 	/*
 	 * Ensure that any loads or stores on the writer side reach
@@ -201,22 +841,35 @@ ebr_sync(ebr_t *ebr, unsigned *gc_epoch)
 	atomic_thread_fence(memory_order_seq_cst);
 
 	/*
-	 * Check whether all active workers observed the global epoch.
+	 * In the asymmetric mode, the readers issue only the compiler
+	 * barriers: force a memory barrier on all the running threads,
+	 * so that their local epochs (and critical path accesses) are
+	 * globally visible before we inspect them.
 	 */
-	LIST_FOREACH(t, &ebr->list, entry) {
-		unsigned local_epoch;
-		bool active;
-
-		local_epoch = atomic_load_explicit(&t->local_epoch,
-		    memory_order_relaxed);
-		active = (local_epoch & ACTIVE_FLAG) != 0;
+	if (ebr->flags & EBR_MEMBARRIER) {
+		ebr_membarrier();
+	}
 
-		if (active && (local_epoch != (epoch | ACTIVE_FLAG))) {
-			/* No, not ready. */
-			*gc_epoch = ebr_gc_epoch(ebr);
-			return false;
+	/*
+	 * Check whether all active workers observed the global epoch.
+	 */
+	if (!ebr_observed_p(ebr, epoch, &laggard)) {
+		/*
+		 * No, not ready.  Record the stall of the worker holding
+		 * back the epoch, if known, or check all of them.
+		 */
+		if (__predict_false(ebr->watchdog)) {
+			(void)ebr_laggards_scan(ebr, NULL, 0, true);
+		} else if (laggard) {
+			uint64_t now = 0;
+			(void)ebr_stall_note(laggard, ebr->sync_ok, &now);
 		}
+		*gc_epoch = ebr_gc_epoch(ebr);
+		atomic_store_explicit(&ebr->sync_busy, 0, memory_order_release);
+		atomic_fetch_add(&ebr->sync_fail, 1);
+		return false;
 	}
+	atomic_fetch_add(&ebr->sync_ok, 1);
 
 	/* Yes: increment and announce a new global epoch. */
 	atomic_store_explicit(&ebr->global_epoch,
@@ -241,6 +894,7 @@ ebr_sync(ebr_t *ebr, unsigned *gc_epoch)
 	 *    path in the e-2 epoch.  This is the epoch ready for G/C.
 	 */
 	*gc_epoch = ebr_gc_epoch(ebr);
+	atomic_store_explicit(&ebr->sync_busy, 0, memory_order_release);
 	return true;
 }
 
@@ -269,6 +923,70 @@ ebr_gc_epoch(ebr_t *ebr)
 	return (ebr->global_epoch + 1) % 3;
 }
 
+/*
+ * ebr_wait: wait until a worker holding back the epoch leaves the
+ * critical path or for the given time at most; zero means no timeout.
+ *
+ * => Returns false immediately if no worker holds back the epoch;
+ *    otherwise, returns true.
+ */
+bool
+ebr_wait(ebr_t *ebr, unsigned msec)
+{
+	const uint64_t start = clock_nsec();
+	ebr_tls_t *laggard = NULL;
+	bool blocked = false;
+	unsigned epoch;
+
+	atomic_fetch_add(&ebr->waiters, 1);
+
+	/*
+	 * Publish the presence before checking the workers.  Note: the
+	 * atomic operation is a full barrier.
+	 */
+	if (ebr->flags & EBR_MEMBARRIER) {
+		ebr_membarrier();
+	}
+	epoch = atomic_load_explicit(&ebr->global_epoch, memory_order_relaxed);
+	for (;;) {
+		const unsigned seq = atomic_load_explicit(&ebr->wait_seq,
+		    memory_order_acquire);
+		unsigned slice = EBR_WAIT_SLICE;
+
+		/*
+		 * Done if the workers have left or someone else has
+		 * already announced a new epoch.
+		 */
+		if (ebr_observed_p(ebr, epoch, &laggard) ||
+		    epoch != ebr->global_epoch) {
+			break;
+		}
+		if (msec) {
+			const uint64_t elapsed = clock_nsec() - start;
+			const uint64_t timeout = (uint64_t)msec * 1000000;
+			uint64_t left;
+
+			if (elapsed >= timeout) {
+				break;
+			}
+			left = timeout - elapsed;
+			if (left < (uint64_t)slice * 1000000) {
+				slice = (unsigned)(left / 1000000) + 1;
+			}
+		}
+		ebr_futex_wait(&ebr->wait_seq, seq, slice);
+		blocked = true;
+	}
+	atomic_fetch_add(&ebr->waiters, -1);
+	return blocked;
+}
+
+/*
+ * ebr_full_sync: synchronise until the epoch of the objects staged at
+ * the time of the call is ready for reclamation.  Spin for a little bit
+ * and then wait for the workers holding back the epoch (for msec_retry
+ * at most before retrying or, if zero, until they leave).
+ */
 void
 ebr_full_sync(ebr_t *ebr, unsigned msec_retry)
 {
@@ -279,10 +997,13 @@ wait:
 	while (!ebr_sync(ebr, &epoch)) {
 		if (count < SPINLOCK_BACKOFF_MAX) {
 			SPINLOCK_BACKOFF(count);
-		} else if (msec_retry) {
-			(void)nanosleep(&dtime, NULL);
-		} else {
-			sched_yield();
+		} else if (!ebr_wait(ebr, msec_retry)) {
+			/* Racing with another synchroniser. */
+			if (msec_retry) {
+				(void)nanosleep(&dtime, NULL);
+			} else {
+				sched_yield();
+			}
 		}
 	}
 	if (target_epoch != epoch) {
@@ -290,6 +1011,39 @@ wait:
 	}
 }
 
+/*
+ * ebr_get_stats: get the statistics of the EBR object.
+ */
+void
+ebr_get_stats(ebr_t *ebr, ebr_stats_t *stats)
+{
+	const unsigned nchunks = ebr->nchunks;
+
+	stats->nthreads = 0;
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = EBR_CHUNK_SLOTS << i;
+
+		for (unsigned j = 0; j < nslots; j++) {
+			stats->nthreads += ebr->chunks[i][j].used != 0;
+		}
+	}
+	stats->sync_ok = ebr->sync_ok;
+	stats->sync_fail = ebr->sync_fail;
+}
+
+/*
+ * ebr_incrit_p_h: return true if the worker, given its handle, is in
+ * the critical path, i.e. called ebr_enter(); otherwise, return false.
+ */
+bool
+ebr_incrit_p_h(ebr_t *ebr, ebr_tls_t *t)
+{
+	ASSERT(t != NULL);
+	(void)ebr;
+
+	return (t->local_epoch & ACTIVE_FLAG) != 0;
+}
+
 /*
  * ebr_incrit_p: return true if the current worker is in the critical path,
  * i.e. called ebr_enter(); otherwise, return false.
@@ -299,10 +1053,5 @@ wait:
 bool
 ebr_incrit_p(ebr_t *ebr)
 {
-	ebr_tls_t *t;
-
-	t = pthread_getspecific(ebr->tls_key);
-	ASSERT(t != NULL);
-
-	return (t->local_epoch & ACTIVE_FLAG) != 0;
+	return ebr_incrit_p_h(ebr, pthread_getspecific(ebr->tls_key));
 }
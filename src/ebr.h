@@ -8,17 +8,51 @@
 #ifndef	_EBR_H_
 #define	_EBR_H_
 
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 __BEGIN_DECLS
 
 struct ebr;
 typedef struct ebr ebr_t;
 
+struct ebr_tls;
+typedef struct ebr_tls ebr_tls_t;
+
 #define	EBR_EPOCHS	3
 
+/*
+ * Flags for ebr_create_ex().
+ */
+#define	EBR_MEMBARRIER	0x01
+#define	EBR_HIERARCHICAL	0x02
+
+typedef struct {
+	unsigned	nthreads;
+	uint64_t	sync_ok;
+	uint64_t	sync_fail;
+} ebr_stats_t;
+
+/*
+ * The worker holding back the epoch: its label and for how long it has
+ * been stalled in the critical path.
+ */
+#define	EBR_LABEL_LEN	16
+
+typedef struct {
+	char		label[EBR_LABEL_LEN];
+	uint64_t	stall_nsec;
+} ebr_laggard_t;
+
+typedef void (*ebr_watchdog_t)(const ebr_laggard_t *, void *);
+
 ebr_t *		ebr_create(void);
+ebr_t *		ebr_create_ex(unsigned);
 void		ebr_destroy(ebr_t *);
 int		ebr_register(ebr_t *);
 void		ebr_unregister(ebr_t *);
+bool		ebr_registered_p(ebr_t *);
 
 void		ebr_enter(ebr_t *);
 void		ebr_exit(ebr_t *);
@@ -26,7 +60,18 @@ bool		ebr_sync(ebr_t *, unsigned *);
 unsigned	ebr_staging_epoch(ebr_t *);
 unsigned	ebr_gc_epoch(ebr_t *);
 void		ebr_full_sync(ebr_t *, unsigned);
+bool		ebr_wait(ebr_t *, unsigned);
 bool		ebr_incrit_p(ebr_t *);
+void		ebr_get_stats(ebr_t *, ebr_stats_t *);
+
+void		ebr_set_label(ebr_t *, const char *);
+unsigned	ebr_laggards(ebr_t *, ebr_laggard_t *, unsigned);
+void		ebr_set_watchdog(ebr_t *, unsigned, ebr_watchdog_t, void *);
+
+ebr_tls_t *	ebr_register_h(ebr_t *);
+void		ebr_enter_h(ebr_t *, ebr_tls_t *);
+void		ebr_exit_h(ebr_t *, ebr_tls_t *);
+bool		ebr_incrit_p_h(ebr_t *, ebr_tls_t *);
 
 __END_DECLS
 
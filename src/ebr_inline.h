@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * The inline reader fast paths of EBR: ebr_enter_inline() and
+ * ebr_exit_inline() are equivalent to ebr_enter_h() and ebr_exit_h(),
+ * but avoid the function call (and, with the shared library, the PLT).
+ * They access the published leading members of the EBR object and the
+ * worker slot; the layout is private to the library version, therefore
+ * the callers must be rebuilt with the library (e.g. linked statically).
+ * The hierarchical mode and the wakeup of the waiters take the regular
+ * out-of-line paths.
+ */
+
+#ifndef	_EBR_INLINE_H_
+#define	_EBR_INLINE_H_
+
+#include "ebr.h"
+
+__BEGIN_DECLS
+
+#define	EBR_ACTIVE_FLAG		(0x80000000U)
+
+/*
+ * The published layout: the leading members of the EBR object (the
+ * global epoch and the flags) and of the worker slot (the local epoch).
+ */
+typedef struct {
+	unsigned	global_epoch;
+	unsigned	flags;
+} ebr_pub_t;
+
+typedef struct {
+	unsigned	local_epoch;
+} ebr_tls_pub_t;
+
+#define	EBR_PUB(ebr, m)	\
+    ((const ebr_pub_t *)(const void *)(ebr))->m
+#define	EBR_TLS_PUB(t, m) \
+    ((ebr_tls_pub_t *)(void *)(t))->m
+
+void		ebr_wakeup(ebr_t *);
+
+static inline void
+ebr_enter_inline(ebr_t *ebr, ebr_tls_t *t)
+{
+	const unsigned flags = EBR_PUB(ebr, flags);
+	unsigned epoch;
+
+	if (__builtin_expect((flags & EBR_HIERARCHICAL) != 0, 0)) {
+		ebr_enter_h(ebr, t);
+		return;
+	}
+	epoch = EBR_PUB(ebr, global_epoch);
+	__atomic_store_n(&EBR_TLS_PUB(t, local_epoch),
+	    epoch | EBR_ACTIVE_FLAG, __ATOMIC_RELAXED);
+	if (flags & EBR_MEMBARRIER) {
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	} else {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
+static inline void
+ebr_exit_inline(ebr_t *ebr, ebr_tls_t *t)
+{
+	const unsigned flags = EBR_PUB(ebr, flags);
+	unsigned epoch;
+
+	if (__builtin_expect((flags & EBR_HIERARCHICAL) != 0, 0)) {
+		ebr_exit_h(ebr, t);
+		return;
+	}
+	epoch = EBR_TLS_PUB(t, local_epoch) & ~EBR_ACTIVE_FLAG;
+	if (flags & EBR_MEMBARRIER) {
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	} else {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+	__atomic_store_n(&EBR_TLS_PUB(t, local_epoch), 0, __ATOMIC_RELAXED);
+
+	if (__builtin_expect(epoch != EBR_PUB(ebr, global_epoch), 0)) {
+		ebr_wakeup(ebr);
+	}
+}
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Process-shared epoch-based reclamation (EBR) domain.
+ *
+ * The same algorithm as in ebr.c (see the comments there), but the
+ * domain lives in the caller-provided memory, e.g. a MAP_SHARED mapping,
+ * so that the processes can share one set of the readers and reclaimers.
+ * Therefore, the domain contains no pointers, no process-local locks or
+ * TLS: the participants occupy the fixed slots, which immediately follow
+ * the header, and the workers refer to them by the index returned on
+ * registration.  The mapping may reside at different addresses in each
+ * process; the objects shared by the workers should be referenced using
+ * the offsets relative to the mapping.
+ *
+ * The enter/exit and sync paths are the same as in the (flat) threaded
+ * version; the asymmetric barriers are not supported, since membarrier(2)
+ * applies only to the threads of the calling process.
+ *
+ * The slots (and the synchronisation flag) record the PID of the owner,
+ * so the slots left by the processes which exited without unregistering
+ * (e.g. crashed) can be recovered using ebr_shm_reap().
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "ebr_shm.h"
+#include "ebr.h"
+#include "utils.h"
+
+#define	ACTIVE_FLAG		(0x80000000U)
+#define	EBR_SHM_MAGIC		(0xeb5a0001U)
+
+/*
+ * The owner of a slot being reaped: never a valid PID, therefore the
+ * slot cannot be claimed until the reaper has cleared it.
+ */
+#define	EBR_SHM_REAPING		(~0U)
+
+typedef struct {
+	/*
+	 * - A local epoch counter for each worker, which may have the
+	 *   "active" flag set.
+	 * - The PID of the process owning the slot, EBR_SHM_REAPING
+	 *   or zero, if free.
+	 */
+	unsigned		local_epoch;
+	unsigned		owner;
+} __aligned(CACHE_LINE_SIZE) ebr_shm_slot_t;
+
+struct ebr_shm {
+	/*
+	 * - The magic value (set last, once initialised) and the number
+	 *   of the slots.
+	 * - The global epoch counter which can be 0, 1 or 2.
+	 */
+	unsigned		magic;
+	unsigned		nslots;
+	unsigned		global_epoch;
+
+	/*
+	 * The PID of the process synchronising (it serialises the
+	 * concurrent ebr_shm_sync() calls) and the statistics.  Keep
+	 * these on a separate cache line, since the readers access
+	 * the global epoch.
+	 */
+	unsigned		sync_busy __aligned(CACHE_LINE_SIZE);
+	uint64_t		sync_ok;
+	uint64_t		sync_fail;
+
+	/*
+	 * The slots of the workers.
+	 */
+	ebr_shm_slot_t		slots[];
+};
+
+/*
+ * ebr_shm_size: return the size of the memory needed for the domain
+ * with the given number of slots.
+ */
+size_t
+ebr_shm_size(unsigned nslots)
+{
+	return sizeof(ebr_shm_t) + nslots * sizeof(ebr_shm_slot_t);
+}
+
+/*
+ * ebr_shm_init: initialise the domain in the given memory, which must be
+ * aligned to the cache line size (e.g. a page).  Only one process
+ * (typically, the parent) shall do this, before the others attach.
+ *
+ * => Returns the domain or NULL on failure (errno is set).
+ */
+ebr_shm_t *
+ebr_shm_init(void *mem, size_t len, unsigned nslots)
+{
+	ebr_shm_t *shm = mem;
+
+	if (nslots == 0 || len < ebr_shm_size(nslots) ||
+	    ((uintptr_t)mem & (CACHE_LINE_SIZE - 1)) != 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	memset(shm, 0, ebr_shm_size(nslots));
+	shm->nslots = nslots;
+	atomic_store_explicit(&shm->magic, EBR_SHM_MAGIC, memory_order_release);
+	return shm;
+}
+
+/*
+ * ebr_shm_attach: attach to the domain initialised in the given memory
+ * (possibly, mapped at a different address).
+ *
+ * => Returns the domain or NULL on failure (errno is set).
+ */
+ebr_shm_t *
+ebr_shm_attach(void *mem, size_t len)
+{
+	ebr_shm_t *shm = mem;
+
+	if (len < sizeof(ebr_shm_t) ||
+	    atomic_load_explicit(&shm->magic, memory_order_acquire) !=
+	    EBR_SHM_MAGIC || len < ebr_shm_size(shm->nslots)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return shm;
+}
+
+/*
+ * ebr_shm_register: claim a slot for the current worker (a process or
+ * a thread of the process).
+ *
+ * => Returns the slot index or -1 on failure (errno is set).
+ */
+int
+ebr_shm_register(ebr_shm_t *shm)
+{
+	const unsigned pid = (unsigned)getpid();
+
+	for (unsigned i = 0; i < shm->nslots; i++) {
+		ebr_shm_slot_t *slot = &shm->slots[i];
+
+		if (!slot->owner &&
+		    atomic_compare_exchange_weak(&slot->owner, 0, pid)) {
+			return (int)i;
+		}
+	}
+	errno = ENOSPC;
+	return -1;
+}
+
+/*
+ * ebr_shm_unregister: release the slot of the worker.
+ */
+void
+ebr_shm_unregister(ebr_shm_t *shm, unsigned i)
+{
+	ebr_shm_slot_t *slot = &shm->slots[i];
+
+	ASSERT(i < shm->nslots);
+	ASSERT((slot->local_epoch & ACTIVE_FLAG) == 0);
+	atomic_store_explicit(&slot->local_epoch, 0, memory_order_relaxed);
+	atomic_store_explicit(&slot->owner, 0, memory_order_release);
+}
+
+/*
+ * ebr_shm_dead_p: return true if the process is gone.
+ */
+static bool
+ebr_shm_dead_p(unsigned pid)
+{
+	return kill((pid_t)pid, 0) == -1 && errno == ESRCH;
+}
+
+/*
+ * ebr_shm_reap: release the slots (and the synchronisation flag) owned
+ * by the processes which exited without unregistering.  Note: the PIDs
+ * may be reused, therefore this is best-effort.
+ *
+ * => Returns the number of the slots released.
+ */
+unsigned
+ebr_shm_reap(ebr_shm_t *shm)
+{
+	unsigned pid, nreaped = 0;
+
+	for (unsigned i = 0; i < shm->nslots; i++) {
+		ebr_shm_slot_t *slot = &shm->slots[i];
+
+		pid = atomic_load_explicit(&slot->owner, memory_order_relaxed);
+		if (pid == 0 || pid == EBR_SHM_REAPING ||
+		    !ebr_shm_dead_p(pid)) {
+			continue;
+		}
+
+		/*
+		 * Take over the slot first: otherwise, a concurrent reaper
+		 * could release it and a new owner could claim it before
+		 * we clear the local epoch of its critical path.
+		 */
+		if (!atomic_compare_exchange_weak(&slot->owner,
+		    pid, EBR_SHM_REAPING)) {
+			continue;
+		}
+		atomic_store_explicit(&slot->local_epoch, 0,
+		    memory_order_relaxed);
+		atomic_store_explicit(&slot->owner, 0, memory_order_release);
+		nreaped++;
+	}
+	pid = atomic_load_explicit(&shm->sync_busy, memory_order_relaxed);
+	if (pid && ebr_shm_dead_p(pid)) {
+		atomic_compare_exchange_weak(&shm->sync_busy, pid, 0);
+	}
+	return nreaped;
+}
+
+/*
+ * ebr_shm_enter: mark the entrance to the critical path.
+ */
+void
+ebr_shm_enter(ebr_shm_t *shm, unsigned i)
+{
+	ebr_shm_slot_t *slot = &shm->slots[i];
+	unsigned epoch;
+
+	ASSERT(i < shm->nslots && slot->owner);
+
+	/*
+	 * Set the "active" flag and observe the global epoch.  Ensure
+	 * that the epoch is observed before any loads in the critical
+	 * path.
+	 */
+	epoch = shm->global_epoch;
+	atomic_store_explicit(&slot->local_epoch,
+	    epoch | ACTIVE_FLAG, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*
+ * ebr_shm_exit: mark the exit of the critical path.
+ */
+void
+ebr_shm_exit(ebr_shm_t *shm, unsigned i)
+{
+	ebr_shm_slot_t *slot = &shm->slots[i];
+
+	/*
+	 * Clear the "active" flag.  Must ensure that any stores in
+	 * the critical path reach global visibility before that.
+	 */
+	ASSERT(i < shm->nslots);
+	ASSERT(slot->local_epoch & ACTIVE_FLAG);
+	atomic_thread_fence(memory_order_seq_cst);
+	atomic_store_explicit(&slot->local_epoch, 0, memory_order_relaxed);
+}
+
+/*
+ * ebr_shm_observed_p: return true if all active workers observed the
+ * given epoch.
+ */
+static bool
+ebr_shm_observed_p(ebr_shm_t *shm, unsigned epoch)
+{
+	for (unsigned i = 0; i < shm->nslots; i++) {
+		unsigned local_epoch;
+
+		local_epoch = atomic_load_explicit(
+		    &shm->slots[i].local_epoch, memory_order_relaxed);
+		if ((local_epoch & ACTIVE_FLAG) &&
+		    local_epoch != (epoch | ACTIVE_FLAG)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * ebr_shm_sync: attempt to synchronise and announce a new epoch.
+ * The same semantics as ebr_sync().
+ *
+ * => Return true if a new epoch was announced.
+ * => Return the epoch ready for reclamation.
+ */
+bool
+ebr_shm_sync(ebr_shm_t *shm, unsigned *gc_epoch)
+{
+	const unsigned pid = (unsigned)getpid();
+	unsigned epoch;
+
+	if (shm->sync_busy ||
+	    !atomic_compare_exchange_weak(&shm->sync_busy, 0, pid)) {
+		*gc_epoch = ebr_shm_gc_epoch(shm);
+		atomic_fetch_add(&shm->sync_fail, 1);
+		return false;
+	}
+	epoch = atomic_load_explicit(&shm->global_epoch, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (!ebr_shm_observed_p(shm, epoch)) {
+		*gc_epoch = ebr_shm_gc_epoch(shm);
+		atomic_store_explicit(&shm->sync_busy, 0, memory_order_release);
+		atomic_fetch_add(&shm->sync_fail, 1);
+		return false;
+	}
+	atomic_fetch_add(&shm->sync_ok, 1);
+	atomic_store_explicit(&shm->global_epoch,
+	    (epoch + 1) % EBR_EPOCHS, memory_order_relaxed);
+
+	*gc_epoch = ebr_shm_gc_epoch(shm);
+	atomic_store_explicit(&shm->sync_busy, 0, memory_order_release);
+	return true;
+}
+
+/*
+ * ebr_shm_staging_epoch: return the epoch where objects can be staged
+ * for reclamation.
+ */
+unsigned
+ebr_shm_staging_epoch(ebr_shm_t *shm)
+{
+	return shm->global_epoch;
+}
+
+/*
+ * ebr_shm_gc_epoch: return the epoch where objects are ready to be
+ * reclaimed.
+ */
+unsigned
+ebr_shm_gc_epoch(ebr_shm_t *shm)
+{
+	return (shm->global_epoch + 1) % EBR_EPOCHS;
+}
+
+void
+ebr_shm_full_sync(ebr_shm_t *shm, unsigned msec_retry)
+{
+	const struct timespec dtime = { 0, msec_retry * 1000 * 1000 };
+	const unsigned target_epoch = ebr_shm_staging_epoch(shm);
+	unsigned epoch, count = SPINLOCK_BACKOFF_MIN;
+wait:
+	while (!ebr_shm_sync(shm, &epoch)) {
+		if (count < SPINLOCK_BACKOFF_MAX) {
+			SPINLOCK_BACKOFF(count);
+		} else if (msec_retry) {
+			(void)nanosleep(&dtime, NULL);
+		} else {
+			sched_yield();
+		}
+	}
+	if (target_epoch != epoch) {
+		goto wait;
+	}
+}
+
+/*
+ * ebr_shm_get_stats: get the statistics of the domain.
+ */
+void
+ebr_shm_get_stats(ebr_shm_t *shm, ebr_shm_stats_t *stats)
+{
+	stats->nslots = shm->nslots;
+	stats->nused = 0;
+	for (unsigned i = 0; i < shm->nslots; i++) {
+		stats->nused += shm->slots[i].owner != 0;
+	}
+	stats->sync_ok = shm->sync_ok;
+	stats->sync_fail = shm->sync_fail;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+#ifndef	_EBR_SHM_H_
+#define	_EBR_SHM_H_
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_DECLS
+
+struct ebr_shm;
+typedef struct ebr_shm ebr_shm_t;
+
+typedef struct {
+	unsigned	nslots;
+	unsigned	nused;
+	uint64_t	sync_ok;
+	uint64_t	sync_fail;
+} ebr_shm_stats_t;
+
+size_t		ebr_shm_size(unsigned);
+ebr_shm_t *	ebr_shm_init(void *, size_t, unsigned);
+ebr_shm_t *	ebr_shm_attach(void *, size_t);
+
+int		ebr_shm_register(ebr_shm_t *);
+void		ebr_shm_unregister(ebr_shm_t *, unsigned);
+unsigned	ebr_shm_reap(ebr_shm_t *);
+
+void		ebr_shm_enter(ebr_shm_t *, unsigned);
+void		ebr_shm_exit(ebr_shm_t *, unsigned);
+bool		ebr_shm_sync(ebr_shm_t *, unsigned *);
+unsigned	ebr_shm_staging_epoch(ebr_shm_t *);
+unsigned	ebr_shm_gc_epoch(ebr_shm_t *);
+void		ebr_shm_full_sync(ebr_shm_t *, unsigned);
+void		ebr_shm_get_stats(ebr_shm_t *, ebr_shm_stats_t *);
+
+__END_DECLS
+
+#endif
@@ -8,24 +8,172 @@
 /*
  * Garbage Collection (G/C) interface for multi-threaded environment,
  * using the Epoch-based reclamation (EBR) mechanism.
+ *
+ * Each registered thread has its own limbo lists, one for each epoch.
+ * The objects are inserted into the list of the current global epoch,
+ * observed while the thread is in the critical path.  Since the global
+ * epoch cannot advance more than once while the thread is in the critical
+ * path, the list it inserts into cannot be the one being collected by
+ * gc_cycle(); therefore, no atomic operations are needed for insertion.
+ * The threads which are not registered use the global limbo list.
+ *
+ * The G/C cycles may be driven by the callers or by the background
+ * worker thread, see gc_start_worker().  The large lists of the objects
+ * ready for reclamation may be split into chunks and reclaimed by a pool
+ * of the helper threads in parallel, see gc_start_helpers().
+ *
+ * The objects may be allocated from the G/C object pools, see gc_alloc().
+ * With the GC_POOL flag, the reclaimed objects are returned to the pools
+ * instead of being freed, so they are recycled without going through the
+ * global allocator.  Each registered thread caches a batch of the free
+ * objects for each size class; the full batches are exchanged with the
+ * global depot, protected by a lock.
+ *
+ * Alternatively, the G/C can use the Quiescent state based reclamation
+ * (QSBR) mechanism, see gc_create_ex() and the GC_QSBR flag.  The readers
+ * then have no critical path; instead, they periodically indicate the
+ * quiescent state using gc_checkpoint().  The G/C maintains its own
+ * epoch with three lists on top of QSBR: it advances when all threads
+ * have passed a checkpoint since the previous advance (i.e. observed
+ * the QSBR barrier issued at that point).  The insertion reads the epoch
+ * between the checkpoints, therefore the epoch cannot advance twice
+ * while the thread is inserting -- the same guarantee as with EBR.
  */
 
+#include <sys/queue.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <inttypes.h>
 #include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "gc.h"
 #include "ebr.h"
+#include "qsbr.h"
 #include "utils.h"
 
+/*
+ * The object pool: the size classes (power of two block sizes, including
+ * the header) and the number of objects in a batch.  The blocks larger
+ * than the largest class are not pooled.  The depot holds at most the
+ * given number of batches for each class; the rest are freed.
+ */
+#define	GC_POOL_MINSHIFT	5
+#define	GC_POOL_CLASSES		8
+#define	GC_POOL_LARGE		GC_POOL_CLASSES
+#define	GC_POOL_BATCH		32
+#define	GC_POOL_DEPOT_MAX	256
+
+/*
+ * The header of the pool allocated object and the free object (its
+ * free list linkage, the next batch and the batch size, if the head).
+ */
+typedef union {
+	unsigned	size_class;
+	max_align_t	_align;
+} gc_objhdr_t;
+
+typedef struct gc_poolobj {
+	struct gc_poolobj *	next;
+	struct gc_poolobj *	batch_next;
+	unsigned		batch_count;
+} gc_poolobj_t;
+
+typedef struct gc_tls {
+	/*
+	 * Per-thread limbo lists, one for each epoch, with the pointers
+	 * to their last entries (for splicing), and the EBR or QSBR
+	 * handle.
+	 */
+	gc_entry_t *		limbo[EBR_EPOCHS];
+	gc_entry_t *		limbo_tail[EBR_EPOCHS];
+	ebr_tls_t *		ebr_tls;
+	qsbr_tls_t *		qsbr_tls;
+	LIST_ENTRY(gc_tls)	entry;
+
+	/*
+	 * The number of objects and bytes in each limbo list.  Also,
+	 * the amounts not yet accounted in the global pending counters
+	 * (they are flushed in batches, see gc_account()).
+	 */
+	size_t			limbo_objs[EBR_EPOCHS];
+	size_t			limbo_bytes[EBR_EPOCHS];
+	size_t			acct_objs;
+	size_t			acct_bytes;
+
+	/*
+	 * Statistics: the number of objects staged by the thread and
+	 * the time when each limbo list received its first object, i.e.
+	 * the retirement time of the oldest object in the list.
+	 */
+	uint64_t		retired;
+	uint64_t		limbo_time[EBR_EPOCHS];
+
+	/*
+	 * The object pool cache: a batch of the free objects for each
+	 * size class, with their counts.
+	 */
+	gc_poolobj_t *		pool[GC_POOL_CLASSES];
+	unsigned		pool_count[GC_POOL_CLASSES];
+} gc_tls_t;
+
+/*
+ * The per-thread accounting is flushed to the global counters once
+ * either of these amounts is accumulated.
+ */
+#define	GC_ACCT_OBJS	64
+#define	GC_ACCT_BYTES	(64 * 1024)
+
+/*
+ * The throttling at the hard limit: the number of the delays (of one
+ * millisecond each, followed by a G/C cycle) while over the limit.
+ */
+#define	GC_THROTTLE_TRIES	4
+
+/*
+ * The latency samples of the objects collected by a G/C cycle: the
+ * retirement time and the number of the objects of each list.  They
+ * are accounted once the reclamation of all chunks has completed.
+ */
+typedef struct {
+	unsigned		refcnt;
+	unsigned		nsamples;
+	unsigned		maxsamples;
+	struct {
+		uint64_t	time;
+		size_t		nobjs;
+	} samples[];
+} gc_lat_t;
+
+/*
+ * The chunk of the objects to be reclaimed by a helper thread.
+ */
+typedef struct gc_job {
+	struct gc_job *		next;
+	gc_entry_t *		list;
+	size_t			nobjs;
+	size_t			nbytes;
+	gc_lat_t *		lat;
+} gc_job_t;
+
+#define	GC_HELPER_CHUNK	1024
+
 struct gc {
 	/*
 	 * Objects are first inserted into the limbo list.  They move
-	 * to a current epoch list on a G/C cycle.
+	 * to a current epoch list on a G/C cycle.  This list is used
+	 * by the threads which are not registered.  Its amounts and the
+	 * retirement time of its oldest object are updated separately
+	 * from the list, i.e. they are approximate (see gc_limbo_push()).
 	 */
 	gc_entry_t *	limbo;
+	size_t		limbo_objs;
+	size_t		limbo_bytes;
+	uint64_t	limbo_time;
 
 	/*
 	 * A separate list for each epoch.  Objects in each list
@@ -33,14 +181,97 @@ struct gc {
 	 * epochs ready to be reclaimed.
 	 */
 	gc_entry_t *	epoch_list[EBR_EPOCHS];
+	size_t		epoch_objs[EBR_EPOCHS];
+	size_t		epoch_bytes[EBR_EPOCHS];
+	uint64_t	epoch_time[EBR_EPOCHS];
 
 	/*
-	 * EBR object and the reclamation function.
+	 * The number of objects and bytes pending reclamation.  Note:
+	 * the values are approximate and may be transiently negative,
+	 * since the per-thread amounts are accounted in batches.  The
+	 * soft and hard limits of the pending amount and the flags.
+	 */
+	int64_t		pending_objs;
+	int64_t		pending_bytes;
+	size_t		soft_limit;
+	size_t		hard_limit;
+	unsigned	limit_flags;
+
+	/*
+	 * EBR object (or QSBR object with the G/C epoch and the barrier
+	 * target to advance it) and the reclamation function.
 	 */
 	ebr_t *		ebr;
+	qsbr_t *	qsbr;
+	qsbr_epoch_t	qsbr_target;
+	unsigned	qsbr_epoch;
 	unsigned	entry_off;
 	gc_func_t	reclaim;
 	void *		arg;
+
+	/*
+	 * TLS with a list of the registered threads and the TLS marking
+	 * the threads running the reclamation function.  The "busy" flag
+	 * marks the G/C cycle in progress (see gc_cycle()); the objects
+	 * are reclaimed after it is cleared, so count such cycles.
+	 */
+	pthread_key_t	tls_key;
+	pthread_key_t	reclaim_key;
+	pthread_mutex_t	lock;
+	LIST_HEAD(, gc_tls) list;
+	unsigned	cycle_busy;
+	unsigned	reclaim_inflight;
+
+	/*
+	 * Background worker: the thread, the lock and condition variable
+	 * to wait on, the G/C period and the state.  The "idle" flag is
+	 * set when there is nothing to reclaim and the worker is sleeping
+	 * until the objects are staged.
+	 */
+	pthread_t	worker;
+	pthread_mutex_t	worker_lock;
+	pthread_cond_t	worker_cv;
+	unsigned	worker_period;
+	bool		worker_running;
+	bool		worker_stop;
+	bool		worker_idle;
+
+	/*
+	 * Helper pool for the parallel reclamation: the threads, the
+	 * queue of the chunks (with the lock and condition variable to
+	 * wait on), the chunk size, the number of chunks queued or being
+	 * reclaimed, the number of the cycles splitting their objects into
+	 * the chunks and the state.
+	 */
+	pthread_t *	helpers;
+	unsigned	nhelpers;
+	size_t		helper_chunk;
+	pthread_mutex_t	helper_lock;
+	pthread_cond_t	helper_cv;
+	gc_job_t *	helper_queue;
+	unsigned	helper_inflight;
+	unsigned	helper_dispatch;
+	bool		helper_stop;
+
+	/*
+	 * The object pool depot: a list of the batches for each size
+	 * class, with their counts, and the lock protecting them.
+	 */
+	pthread_mutex_t	pool_lock;
+	gc_poolobj_t *	pool[GC_POOL_CLASSES];
+	unsigned	pool_batches[GC_POOL_CLASSES];
+
+	/*
+	 * Statistics: the number of registered threads, the objects
+	 * retired by the unregistered (or the gone) threads, the objects
+	 * staged from the global limbo list and the objects reclaimed.
+	 * Also, the reclamation latency histogram.
+	 */
+	unsigned	nthreads;
+	uint64_t	retired;
+	uint64_t	staged;
+	uint64_t	reclaimed;
+	uint64_t	latency[GC_LATENCY_BUCKETS];
 };
 
 static void
@@ -57,151 +288,1492 @@ gc_default_reclaim(gc_entry_t *entry, void *arg)
 	}
 }
 
+/*
+ * gc_pool_release: release all objects in the free list.
+ */
+static void
+gc_pool_release(gc_poolobj_t *obj)
+{
+	while (obj) {
+		gc_poolobj_t *next = obj->next;
+		free(obj);
+		obj = next;
+	}
+}
+
+/*
+ * gc_pool_put: put a batch of the free objects into the depot or, if
+ * the depot is full, release them.
+ */
+static void
+gc_pool_put(gc_t *gc, unsigned c, gc_poolobj_t *batch, unsigned count)
+{
+	pthread_mutex_lock(&gc->pool_lock);
+	if (gc->pool_batches[c] < GC_POOL_DEPOT_MAX) {
+		batch->batch_next = gc->pool[c];
+		batch->batch_count = count;
+		gc->pool[c] = batch;
+		gc->pool_batches[c]++;
+		batch = NULL;
+	}
+	pthread_mutex_unlock(&gc->pool_lock);
+	gc_pool_release(batch);
+}
+
+/*
+ * gc_pool_reclaim: the GC_POOL reclamation, returning the objects to
+ * the object pools.  If the caller is not registered (e.g. the worker
+ * or a helper thread), then gather the objects into the batches.
+ */
+static void
+gc_pool_reclaim(gc_entry_t *entry, void *arg)
+{
+	gc_poolobj_t *batch[GC_POOL_CLASSES] = { NULL };
+	unsigned count[GC_POOL_CLASSES] = { 0 };
+	gc_t *gc = arg;
+	const unsigned off = gc->entry_off;
+	const bool registered = pthread_getspecific(gc->tls_key) != NULL;
+	void *obj;
+
+	while (entry) {
+		gc_poolobj_t *pobj;
+		gc_objhdr_t *hdr;
+		unsigned c;
+
+		obj = (void *)((uintptr_t)entry - off);
+		entry = entry->next;
+
+		hdr = (gc_objhdr_t *)obj - 1;
+		if (registered || (c = hdr->size_class) == GC_POOL_LARGE) {
+			gc_free(gc, obj);
+			continue;
+		}
+		pobj = (void *)hdr;
+		pobj->next = batch[c];
+		batch[c] = pobj;
+		if (++count[c] == GC_POOL_BATCH) {
+			gc_pool_put(gc, c, batch[c], count[c]);
+			batch[c] = NULL;
+			count[c] = 0;
+		}
+	}
+	for (unsigned c = 0; c < GC_POOL_CLASSES; c++) {
+		if (batch[c]) {
+			gc_pool_put(gc, c, batch[c], count[c]);
+		}
+	}
+}
+
+/*
+ * gc_backend_destroy: destroy the EBR or QSBR object.
+ */
+static void
+gc_backend_destroy(gc_t *gc)
+{
+	if (gc->qsbr) {
+		qsbr_destroy(gc->qsbr);
+	} else {
+		ebr_destroy(gc->ebr);
+	}
+}
+
+/*
+ * gc_create_ex: construct the G/C object, given the flags:
+ *
+ * => GC_QSBR: use QSBR instead of EBR (see the notes above).
+ * => GC_POOL: the default reclamation returns the objects, which must be
+ *    allocated with gc_alloc(), to the object pools.
+ */
 gc_t *
-gc_create(unsigned off, gc_func_t reclaim, void *arg)
+gc_create_ex(unsigned off, gc_func_t reclaim, void *arg, unsigned flags)
 {
+	pthread_condattr_t attr;
 	gc_t *gc;
 
 	if ((gc = calloc(1, sizeof(gc_t))) == NULL) {
 		return NULL;
 	}
-	gc->ebr = ebr_create();
-	if (!gc->ebr) {
+	if (flags & GC_QSBR) {
+		if ((gc->qsbr = qsbr_create()) == NULL) {
+			free(gc);
+			return NULL;
+		}
+		gc->qsbr_target = qsbr_barrier(gc->qsbr);
+	} else if ((gc->ebr = ebr_create()) == NULL) {
+		free(gc);
+		return NULL;
+	}
+	if (pthread_key_create(&gc->tls_key, NULL) != 0) {
+		gc_backend_destroy(gc);
+		free(gc);
+		return NULL;
+	}
+	if (pthread_key_create(&gc->reclaim_key, NULL) != 0) {
+		pthread_key_delete(gc->tls_key);
+		gc_backend_destroy(gc);
 		free(gc);
 		return NULL;
 	}
+	pthread_mutex_init(&gc->lock, NULL);
+	pthread_mutex_init(&gc->pool_lock, NULL);
+
+	/*
+	 * The worker lock and condition variable live as long as the
+	 * G/C object: the writers may signal the worker as it stops.
+	 */
+	pthread_mutex_init(&gc->worker_lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&gc->worker_cv, &attr);
+	pthread_condattr_destroy(&attr);
+
 	gc->entry_off = off;
 	if (reclaim) {
 		gc->reclaim = reclaim;
 		gc->arg = arg;
 	} else {
-		gc->reclaim = gc_default_reclaim;
+		gc->reclaim = (flags & GC_POOL) ?
+		    gc_pool_reclaim : gc_default_reclaim;
 		gc->arg = gc;
 	}
 	return gc;
 }
 
+gc_t *
+gc_create(unsigned off, gc_func_t reclaim, void *arg)
+{
+	return gc_create_ex(off, reclaim, arg, 0);
+}
+
 void
 gc_destroy(gc_t *gc)
 {
+	gc_tls_t *t;
+
 	for (unsigned i = 0; i < EBR_EPOCHS; i++) {
 		ASSERT(gc->epoch_list[i] == NULL);
 	}
 	ASSERT(gc->limbo == NULL);
 
-	ebr_destroy(gc->ebr);
+	gc_stop_worker(gc);
+	gc_stop_helpers(gc);
+
+	/*
+	 * Release the records of the threads which did not unregister.
+	 */
+	while ((t = LIST_FIRST(&gc->list)) != NULL) {
+		for (unsigned i = 0; i < EBR_EPOCHS; i++) {
+			ASSERT(t->limbo[i] == NULL);
+		}
+		for (unsigned c = 0; c < GC_POOL_CLASSES; c++) {
+			gc_pool_release(t->pool[c]);
+		}
+		LIST_REMOVE(t, entry);
+		free(t);
+	}
+
+	/*
+	 * Release the object pools.
+	 */
+	for (unsigned c = 0; c < GC_POOL_CLASSES; c++) {
+		gc_poolobj_t *batch;
+
+		while ((batch = gc->pool[c]) != NULL) {
+			gc->pool[c] = batch->batch_next;
+			gc_pool_release(batch);
+		}
+	}
+	pthread_key_delete(gc->reclaim_key);
+	pthread_key_delete(gc->tls_key);
+	pthread_cond_destroy(&gc->worker_cv);
+	pthread_mutex_destroy(&gc->worker_lock);
+	pthread_mutex_destroy(&gc->pool_lock);
+	pthread_mutex_destroy(&gc->lock);
+	gc_backend_destroy(gc);
 	free(gc);
 }
 
-void
+/*
+ * gc_register: register the current thread as a user of the G/C.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
 gc_register(gc_t *gc)
 {
-	ebr_register(gc->ebr);
-}
+	gc_tls_t *t;
+	int ret;
 
-void
-gc_unregister(gc_t *gc)
-{
-	ebr_unregister(gc->ebr);
-}
+	if (pthread_getspecific(gc->tls_key) != NULL) {
+		/* Already registered. */
+		return 0;
+	}
+	ret = posix_memalign((void **)&t, CACHE_LINE_SIZE, sizeof(gc_tls_t));
+	if (ret != 0) {
+		errno = ret;
+		return -1;
+	}
+	memset(t, 0, sizeof(gc_tls_t));
 
-void
-gc_crit_enter(gc_t *gc)
-{
-	ebr_enter(gc->ebr);
-}
+	if (gc->qsbr) {
+		t->qsbr_tls = qsbr_register_h(gc->qsbr);
+	} else {
+		t->ebr_tls = ebr_register_h(gc->ebr);
+	}
+	if (t->qsbr_tls == NULL && t->ebr_tls == NULL) {
+		free(t);
+		return -1;
+	}
+	pthread_setspecific(gc->tls_key, t);
 
-void
-gc_crit_exit(gc_t *gc)
-{
-	ebr_exit(gc->ebr);
+	pthread_mutex_lock(&gc->lock);
+	LIST_INSERT_HEAD(&gc->list, t, entry);
+	gc->nthreads++;
+	pthread_mutex_unlock(&gc->lock);
+	return 0;
 }
 
 /*
- * gc_limbo: insert into the limbo list.
+ * gc_limbo_push: insert a chain of entries, retired at the given time,
+ * into the global limbo list, using a single atomic operation.
+ *
+ * => The amounts and the time are published before the entries, so
+ *    the G/C cycle taking the entries also takes their amounts (but
+ *    possibly also the amounts of a concurrent insertion in progress).
  */
-void
-gc_limbo(gc_t *gc, void *obj)
+static void
+gc_limbo_push(gc_t *gc, gc_entry_t *first, gc_entry_t *last,
+    size_t nobjs, size_t nbytes, uint64_t rtime)
 {
-	gc_entry_t *ent = (void *)((uintptr_t)obj + gc->entry_off);
 	gc_entry_t *head;
+	uint64_t otime;
 
+	atomic_fetch_add(&gc->limbo_objs, nobjs);
+	atomic_fetch_add(&gc->limbo_bytes, nbytes);
+	do {
+		otime = gc->limbo_time;
+	} while ((otime == 0 || rtime < otime) &&
+	    !atomic_compare_exchange_weak(&gc->limbo_time, otime, rtime));
 	do {
 		head = gc->limbo;
-		ent->next = head;
-	} while (!atomic_compare_exchange_weak(&gc->limbo, head, ent));
+		last->next = head;
+	} while (!atomic_compare_exchange_weak(&gc->limbo, head, first));
+}
+
+/*
+ * gc_registered_p: return true if the current thread is registered.
+ */
+bool
+gc_registered_p(gc_t *gc)
+{
+	return pthread_getspecific(gc->tls_key) != NULL;
 }
 
 void
-gc_cycle(gc_t *gc)
+gc_unregister(gc_t *gc)
 {
-	unsigned count = EBR_EPOCHS, gc_epoch, staging_epoch;
-	ebr_t *ebr = gc->ebr;
-	gc_entry_t *gc_list;
-next:
-	/*
-	 * Call the EBR synchronisation and check whether it announces
-	 * a new epoch.
-	 */
-	if (!ebr_sync(ebr, &gc_epoch)) {
-		/* Not announced -- not ready to reclaim. */
+	gc_tls_t *t;
+
+	t = pthread_getspecific(gc->tls_key);
+	if (t == NULL) {
 		return;
 	}
+	pthread_setspecific(gc->tls_key, NULL);
 
 	/*
-	 * Move the objects from the limbo list into the staging epoch.
+	 * Hand over the remaining objects to the global limbo list.
+	 * Note: the lock prevents gc_cycle() from concurrently collecting.
 	 */
-	staging_epoch = ebr_staging_epoch(ebr);
-	ASSERT(gc->epoch_list[staging_epoch] == NULL);
-	gc->epoch_list[staging_epoch] = atomic_exchange(&gc->limbo, NULL);
+	pthread_mutex_lock(&gc->lock);
+	LIST_REMOVE(t, entry);
+	gc->nthreads--;
+	gc->retired += t->retired;
+	gc->staged += t->retired;
+	for (unsigned i = 0; i < EBR_EPOCHS; i++) {
+		if (t->limbo[i]) {
+			gc_limbo_push(gc, t->limbo[i], t->limbo_tail[i],
+			    t->limbo_objs[i], t->limbo_bytes[i],
+			    t->limbo_time[i]);
+			gc->staged -= t->limbo_objs[i];
+		}
+	}
+	pthread_mutex_unlock(&gc->lock);
+	atomic_fetch_add(&gc->pending_objs, t->acct_objs);
+	atomic_fetch_add(&gc->pending_bytes, t->acct_bytes);
 
 	/*
-	 * Reclaim the objects in the G/C epoch list.
+	 * Hand over the cached free objects to the depot.
 	 */
-	gc_list = gc->epoch_list[gc_epoch];
-	if (!gc_list && count--) {
-		/*
-		 * If there is nothing to G/C -- try a next epoch,
-		 * but loop only for one "full" cycle.
-		 */
-		goto next;
+	for (unsigned c = 0; c < GC_POOL_CLASSES; c++) {
+		if (t->pool[c]) {
+			gc_pool_put(gc, c, t->pool[c], t->pool_count[c]);
+		}
 	}
-	gc->reclaim(gc_list, gc->arg);
-	gc->epoch_list[gc_epoch] = NULL;
+
+	if (gc->qsbr) {
+		qsbr_unregister(gc->qsbr);
+	} else {
+		ebr_unregister(gc->ebr);
+	}
+	free(t);
 }
 
-void
-gc_full(gc_t *gc, unsigned msec_retry)
+/*
+ * gc_pool_class: return the size class for the given object size.
+ */
+static inline unsigned
+gc_pool_class(size_t len)
 {
-	const struct timespec dtime = { 0, msec_retry * 1000 * 1000 };
-	unsigned count = SPINLOCK_BACKOFF_MIN;
-	bool done;
-again:
-	/*
-	 * Run a G/C cycle.
-	 */
-	gc_cycle(gc);
+	size_t bsize = 1UL << GC_POOL_MINSHIFT;
+	unsigned c = 0;
+
+	len += sizeof(gc_objhdr_t);
+	while (bsize < len && c < GC_POOL_LARGE) {
+		bsize <<= 1;
+		c++;
+	}
+	return c;
+}
+
+/*
+ * gc_alloc: allocate an object of the given size, taking it from the
+ * object pool, if possible.  The object may be released with gc_free()
+ * or, if the G/C was created with the GC_POOL flag, retired using the
+ * gc_limbo() family of functions.
+ *
+ * => Returns NULL on failure (errno is set).
+ */
+void *
+gc_alloc(gc_t *gc, size_t len)
+{
+	const unsigned c = gc_pool_class(len);
+	gc_poolobj_t *obj = NULL;
+	gc_objhdr_t *hdr;
+	gc_tls_t *t;
+
+	if (__predict_false(c == GC_POOL_LARGE)) {
+		if ((hdr = malloc(sizeof(gc_objhdr_t) + len)) == NULL) {
+			return NULL;
+		}
+		goto out;
+	}
 
 	/*
-	 * Check all epochs and the limbo list.
+	 * Take an object from the per-thread cache, if registered.
+	 * Otherwise, take a batch (or, if not registered, one object)
+	 * from the depot.
 	 */
-	done = true;
-	for (unsigned i = 0; i < EBR_EPOCHS; i++) {
-		if (gc->epoch_list[i]) {
-			done = false;
-			break;
+	t = pthread_getspecific(gc->tls_key);
+	if (t && (obj = t->pool[c]) != NULL) {
+		t->pool[c] = obj->next;
+		t->pool_count[c]--;
+		goto got;
+	}
+	if (gc->pool[c]) {
+		pthread_mutex_lock(&gc->pool_lock);
+		if ((obj = gc->pool[c]) != NULL) {
+			gc_poolobj_t *next = obj->next;
+
+			if (t == NULL && next) {
+				/* Leave the rest of the batch. */
+				next->batch_next = obj->batch_next;
+				next->batch_count = obj->batch_count - 1;
+				gc->pool[c] = next;
+			} else {
+				gc->pool[c] = obj->batch_next;
+				gc->pool_batches[c]--;
+				if (t) {
+					t->pool[c] = next;
+					t->pool_count[c] = obj->batch_count - 1;
+				}
+			}
 		}
+		pthread_mutex_unlock(&gc->pool_lock);
 	}
-	if (!done || gc->limbo) {
-		/*
-		 * There are objects waiting for reclaim.  Spin-wait or
-		 * sleep for a little bit and try to reclaim them.
-		 */
-		if (count < SPINLOCK_BACKOFF_MAX) {
-			SPINLOCK_BACKOFF(count);
-		} else {
-			(void)nanosleep(&dtime, NULL);
+	if (obj == NULL) {
+		const size_t bsize = 1UL << (GC_POOL_MINSHIFT + c);
+
+		if ((obj = malloc(bsize)) == NULL) {
+			return NULL;
 		}
-		goto again;
 	}
+got:
+	hdr = (void *)obj;
+out:
+	hdr->size_class = c;
+	return (void *)(hdr + 1);
+}
+
+/*
+ * gc_free: return the object, allocated with gc_alloc(), to the object
+ * pool.  It must no longer be referenced, i.e. it was never published
+ * or it has been reclaimed (this is what the GC_POOL reclamation does).
+ */
+void
+gc_free(gc_t *gc, void *ptr)
+{
+	gc_objhdr_t *hdr = (gc_objhdr_t *)ptr - 1;
+	const unsigned c = hdr->size_class;
+	gc_poolobj_t *obj = (void *)hdr;
+	gc_tls_t *t;
+
+	ASSERT(c <= GC_POOL_LARGE);
+	if (__predict_false(c == GC_POOL_LARGE)) {
+		free(hdr);
+		return;
+	}
+
+	/*
+	 * Cache the object, if registered.  Once the batch is full,
+	 * hand it over to the depot.  Otherwise, put the object into
+	 * the depot as a batch on its own.
+	 */
+	t = pthread_getspecific(gc->tls_key);
+	if (t == NULL) {
+		obj->next = NULL;
+		gc_pool_put(gc, c, obj, 1);
+		return;
+	}
+	if (t->pool_count[c] == GC_POOL_BATCH) {
+		gc_pool_put(gc, c, t->pool[c], t->pool_count[c]);
+		t->pool[c] = NULL;
+		t->pool_count[c] = 0;
+	}
+	obj->next = t->pool[c];
+	t->pool[c] = obj;
+	t->pool_count[c]++;
+}
+
+/*
+ * gc_crit_enter: enter the critical path.  No-op in the QSBR mode.
+ */
+void
+gc_crit_enter(gc_t *gc)
+{
+	if (gc->ebr) {
+		ebr_enter(gc->ebr);
+	}
+}
+
+/*
+ * gc_crit_exit: exit the critical path.  No-op in the QSBR mode.
+ */
+void
+gc_crit_exit(gc_t *gc)
+{
+	if (gc->ebr) {
+		ebr_exit(gc->ebr);
+	}
+}
+
+/*
+ * gc_checkpoint: indicate a quiescent state of the current thread, i.e.
+ * the state when it does not hold any references to the objects which
+ * may be reclaimed.  Required only in the QSBR mode; no-op otherwise.
+ */
+void
+gc_checkpoint(gc_t *gc)
+{
+	gc_tls_t *t;
+
+	if (gc->qsbr && (t = pthread_getspecific(gc->tls_key)) != NULL) {
+		qsbr_checkpoint_h(gc->qsbr, t->qsbr_tls);
+	}
+}
+
+/*
+ * gc_incrit_p: return true if the thread may hold the references to
+ * the objects, i.e. it is in the critical path.  Note: in the QSBR mode,
+ * the registered threads are always assumed to be.
+ */
+static inline bool
+gc_incrit_p(gc_t *gc, gc_tls_t *t)
+{
+	return gc->qsbr || ebr_incrit_p_h(gc->ebr, t->ebr_tls);
+}
+
+/*
+ * gc_sync: attempt to synchronise and announce a new epoch; return the
+ * epoch available for reclamation.  See ebr_sync() for the details.
+ *
+ * => Must be called with the lock held.
+ */
+static bool
+gc_sync(gc_t *gc, unsigned *gc_epoch)
+{
+	unsigned epoch;
+
+	if (gc->ebr) {
+		return ebr_sync(gc->ebr, gc_epoch);
+	}
+
+	/*
+	 * QSBR: have all threads passed a checkpoint since the last
+	 * advance of the G/C epoch?  If so, advance it and issue a new
+	 * barrier.  Note: the barrier must be issued after the new epoch
+	 * is globally visible, so that the threads observing the barrier
+	 * would observe the new epoch too.
+	 */
+	epoch = gc->qsbr_epoch;
+	if (!qsbr_observed_p(gc->qsbr, gc->qsbr_target)) {
+		*gc_epoch = (epoch + 1) % EBR_EPOCHS;
+		return false;
+	}
+	epoch = (epoch + 1) % EBR_EPOCHS;
+	atomic_store_explicit(&gc->qsbr_epoch, epoch, memory_order_seq_cst);
+	gc->qsbr_target = qsbr_barrier(gc->qsbr);
+	*gc_epoch = (epoch + 1) % EBR_EPOCHS;
+	return true;
+}
+
+/*
+ * gc_staging_epoch: return the current epoch for the staging.
+ */
+static inline unsigned
+gc_staging_epoch(gc_t *gc)
+{
+	if (gc->ebr) {
+		return ebr_staging_epoch(gc->ebr);
+	}
+	return atomic_load_explicit(&gc->qsbr_epoch, memory_order_relaxed);
+}
+
+/*
+ * gc_worker_wakeup: wake up the worker, since there are objects to
+ * reclaim now (or the reclamation has to be expedited).
+ */
+static void
+gc_worker_wakeup(gc_t *gc)
+{
+	pthread_mutex_lock(&gc->worker_lock);
+	gc->worker_idle = false;
+	pthread_cond_signal(&gc->worker_cv);
+	pthread_mutex_unlock(&gc->worker_lock);
+}
+
+/*
+ * gc_over_limit_p: return true if the pending amount is at or above
+ * the given limit.
+ */
+static inline bool
+gc_over_limit_p(const gc_t *gc, size_t limit)
+{
+	const int64_t pending = (gc->limit_flags & GC_LIMIT_BYTES) ?
+	    gc->pending_bytes : gc->pending_objs;
+	return limit && pending > 0 && (uint64_t)pending >= limit;
+}
+
+/*
+ * gc_pressure: handle the memory pressure i.e. the pending amount
+ * reaching the soft or hard limit.
+ *
+ * => At the soft limit, expedite the G/C cycle.
+ * => At the hard limit, throttle (delay for a bounded time) or block the
+ *    caller, unless it is in the critical path, which includes all the
+ *    registered threads in the QSBR mode, or in the reclamation function:
+ *    it would hold off the very reclamation it waits for.
+ */
+static void
+gc_pressure(gc_t *gc, gc_tls_t *t)
+{
+	const struct timespec dtime = { 0, 1000 * 1000 };
+	unsigned count = SPINLOCK_BACKOFF_MIN, ntries = 0;
+
+	if (!gc_over_limit_p(gc, gc->soft_limit)) {
+		return;
+	}
+	if (gc->worker_running) {
+		gc_worker_wakeup(gc);
+	} else {
+		gc_cycle(gc);
+	}
+	if ((t && gc_incrit_p(gc, t)) ||
+	    pthread_getspecific(gc->reclaim_key) != NULL) {
+		return;
+	}
+	while (gc_over_limit_p(gc, gc->hard_limit)) {
+		if ((gc->limit_flags & GC_LIMIT_BLOCK) == 0) {
+			/* Throttle: give the reclamation a chance. */
+			if (ntries++ == GC_THROTTLE_TRIES) {
+				break;
+			}
+			(void)nanosleep(&dtime, NULL);
+		} else if (count < SPINLOCK_BACKOFF_MAX) {
+			SPINLOCK_BACKOFF(count);
+		} else {
+			(void)nanosleep(&dtime, NULL);
+		}
+		if (!gc->worker_running) {
+			gc_cycle(gc);
+		}
+	}
+}
+
+/*
+ * gc_account: account the objects staged for reclamation and check
+ * whether the limits are reached.
+ */
+static void
+gc_account(gc_t *gc, gc_tls_t *t, size_t nobjs, size_t nbytes)
+{
+	if (t) {
+		/*
+		 * Accumulate the amounts locally and flush in batches,
+		 * so there is no contention on the global counters.
+		 */
+		t->acct_objs += nobjs;
+		t->acct_bytes += nbytes;
+		if (t->acct_objs < GC_ACCT_OBJS &&
+		    t->acct_bytes < GC_ACCT_BYTES) {
+			return;
+		}
+		nobjs = t->acct_objs, t->acct_objs = 0;
+		nbytes = t->acct_bytes, t->acct_bytes = 0;
+	}
+	atomic_fetch_add(&gc->pending_objs, nobjs);
+	atomic_fetch_add(&gc->pending_bytes, nbytes);
+	if (__predict_false(gc->soft_limit)) {
+		gc_pressure(gc, t);
+	}
+}
+
+/*
+ * gc_limbo_local: insert a chain of entries into the limbo list of the
+ * current thread.
+ */
+static void
+gc_limbo_local(gc_t *gc, gc_tls_t *t, gc_entry_t *first, gc_entry_t *last,
+    size_t nobjs, size_t nbytes)
+{
+	ebr_t *ebr = gc->ebr;
+	unsigned epoch;
+	bool incrit;
+
+	/*
+	 * The objects must be already globally invisible: ensure that
+	 * before observing the epoch.  Enter the critical path (unless
+	 * the caller is already in it) to prevent the epoch from being
+	 * advanced twice, i.e. our list being collected.  In the QSBR
+	 * mode, the thread is between the checkpoints, which serves the
+	 * same purpose.  Note: entering the critical path already orders
+	 * the prior stores (or the synchronisation does, in the membarrier
+	 * mode), so the fence is needed only if already in it.
+	 */
+	if ((incrit = gc_incrit_p(gc, t)) == false) {
+		ebr_enter_h(ebr, t->ebr_tls);
+	} else {
+		atomic_thread_fence(memory_order_seq_cst);
+	}
+	epoch = gc_staging_epoch(gc);
+	if ((last->next = t->limbo[epoch]) == NULL) {
+		t->limbo_tail[epoch] = last;
+		t->limbo_time[epoch] = clock_nsec();
+	}
+	t->limbo[epoch] = first;
+	t->limbo_objs[epoch] += nobjs;
+	t->limbo_bytes[epoch] += nbytes;
+	t->retired += nobjs;
+	if (!incrit) {
+		ebr_exit_h(ebr, t->ebr_tls);
+	}
+}
+
+/*
+ * gc_limbo_entries: insert a chain of entries into the limbo list of
+ * the current thread, or the global one if the thread is not registered.
+ */
+static void
+gc_limbo_entries(gc_t *gc, gc_entry_t *first, gc_entry_t *last,
+    size_t nobjs, size_t nbytes)
+{
+	gc_tls_t *t;
+
+	t = pthread_getspecific(gc->tls_key);
+	if (__predict_false(t == NULL)) {
+		/* Note: the atomic push also orders the check below. */
+		gc_limbo_push(gc, first, last, nobjs, nbytes, clock_nsec());
+		atomic_fetch_add(&gc->retired, nobjs);
+	} else {
+		gc_limbo_local(gc, t, first, last, nobjs, nbytes);
+		if (gc->worker_running) {
+			/* Stage before checking the worker, see gc_worker(). */
+			atomic_thread_fence(memory_order_seq_cst);
+		}
+	}
+	gc_account(gc, t, nobjs, nbytes);
+
+	if (__predict_false(gc->worker_idle)) {
+		gc_worker_wakeup(gc);
+	}
+}
+
+/*
+ * gc_limbo: insert into the limbo list.
+ */
+void
+gc_limbo(gc_t *gc, void *obj)
+{
+	gc_entry_t *ent = (void *)((uintptr_t)obj + gc->entry_off);
+	gc_limbo_entries(gc, ent, ent, 1, 0);
+}
+
+/*
+ * gc_limbo_sized: insert into the limbo list, accounting the given
+ * size of the object.
+ */
+void
+gc_limbo_sized(gc_t *gc, void *obj, size_t nbytes)
+{
+	gc_entry_t *ent = (void *)((uintptr_t)obj + gc->entry_off);
+	gc_limbo_entries(gc, ent, ent, 1, nbytes);
+}
+
+/*
+ * gc_limbo_chain: insert a chain of objects into the limbo list.
+ *
+ * => The objects must be linked using their gc_entry_t::next, starting
+ *    from the first object and ending with the last one.
+ * => The count is the number of objects in the chain.
+ * => The chain is spliced into the limbo list using a single atomic
+ *    operation, regardless of its length or whether the caller is
+ *    registered.
+ */
+void
+gc_limbo_chain(gc_t *gc, void *first, void *last, unsigned count)
+{
+	gc_entry_t *fent = (void *)((uintptr_t)first + gc->entry_off);
+	gc_entry_t *lent = (void *)((uintptr_t)last + gc->entry_off);
+
+#if defined(DEBUG)
+	gc_entry_t *ent = fent;
+	unsigned n = 1;
+
+	while (ent != lent) {
+		ent = ent->next;
+		n++;
+	}
+	ASSERT(n == count);
+#endif
+	gc_limbo_entries(gc, fent, lent, count, 0);
+}
+
+/*
+ * gc_account_latency: account the latency of the objects retired at
+ * the given time and reclaimed now.
+ */
+static void
+gc_account_latency(gc_t *gc, uint64_t now, uint64_t rtime, size_t nobjs)
+{
+	uint64_t usec = now > rtime ? (now - rtime) / 1000 : 0;
+	unsigned i = 0;
+
+	while (usec && i < GC_LATENCY_BUCKETS - 1) {
+		usec >>= 1;
+		i++;
+	}
+	atomic_fetch_add(&gc->latency[i], nobjs);
+}
+
+/*
+ * gc_lat_alloc: allocate the latency samples for a G/C cycle, i.e. for
+ * the epoch list and the limbo list of each registered thread.
+ *
+ * => Must be called with the lock held.
+ * => Returns NULL on failure: the latency is accounted on collection.
+ */
+static gc_lat_t *
+gc_lat_alloc(gc_t *gc)
+{
+	const unsigned maxsamples = gc->nthreads + 1;
+	gc_lat_t *lat;
+
+	lat = malloc(offsetof(gc_lat_t, samples[maxsamples]));
+	if (lat) {
+		lat->refcnt = 1;
+		lat->nsamples = 0;
+		lat->maxsamples = maxsamples;
+	}
+	return lat;
+}
+
+/*
+ * gc_lat_add: add the latency sample of the collected list.
+ */
+static void
+gc_lat_add(gc_t *gc, gc_lat_t *lat, uint64_t rtime, size_t nobjs)
+{
+	if (lat == NULL || lat->nsamples == lat->maxsamples) {
+		gc_account_latency(gc, clock_nsec(), rtime, nobjs);
+		return;
+	}
+	lat->samples[lat->nsamples].time = rtime;
+	lat->samples[lat->nsamples].nobjs = nobjs;
+	lat->nsamples++;
+}
+
+/*
+ * gc_lat_release: drop the reference to the latency samples; the last
+ * one, i.e. the reclamation of the last chunk, accounts them.
+ */
+static void
+gc_lat_release(gc_t *gc, gc_lat_t *lat)
+{
+	uint64_t now;
+
+	if (lat == NULL || atomic_fetch_add(&lat->refcnt, -1) != 1) {
+		return;
+	}
+	now = clock_nsec();
+	for (unsigned i = 0; i < lat->nsamples; i++) {
+		gc_account_latency(gc, now, lat->samples[i].time,
+		    lat->samples[i].nobjs);
+	}
+	free(lat);
+}
+
+/*
+ * gc_collect: detach all the objects of the given epoch, i.e. the epoch
+ * list and the limbo lists of the registered threads for that epoch,
+ * recording their latency samples.
+ *
+ * => Must be called with the lock held.
+ */
+static gc_entry_t *
+gc_collect(gc_t *gc, unsigned epoch, size_t *nobjs, size_t *nbytes,
+    gc_lat_t *lat)
+{
+	gc_entry_t *gc_list = gc->epoch_list[epoch];
+	size_t objs = gc->epoch_objs[epoch], bytes = gc->epoch_bytes[epoch];
+	gc_tls_t *t;
+
+	if (gc_list) {
+		gc_lat_add(gc, lat, gc->epoch_time[epoch], objs);
+	}
+	LIST_FOREACH(t, &gc->list, entry) {
+		gc_entry_t *head = t->limbo[epoch];
+
+		if (head) {
+			t->limbo_tail[epoch]->next = gc_list;
+			t->limbo[epoch] = NULL;
+			gc_list = head;
+
+			gc_lat_add(gc, lat, t->limbo_time[epoch],
+			    t->limbo_objs[epoch]);
+			objs += t->limbo_objs[epoch];
+			bytes += t->limbo_bytes[epoch];
+			t->limbo_objs[epoch] = 0;
+			t->limbo_bytes[epoch] = 0;
+		}
+	}
+	gc->epoch_list[epoch] = NULL;
+	gc->epoch_objs[epoch] = 0;
+	gc->epoch_bytes[epoch] = 0;
+
+	*nobjs = objs;
+	*nbytes = bytes;
+	return gc_list;
+}
+
+/*
+ * gc_reclaimed: account the reclaimed objects.
+ */
+static void
+gc_reclaimed(gc_t *gc, size_t nobjs, size_t nbytes)
+{
+	atomic_fetch_add(&gc->reclaimed, nobjs);
+	atomic_fetch_add(&gc->pending_objs, -(int64_t)nobjs);
+	atomic_fetch_add(&gc->pending_bytes, -(int64_t)nbytes);
+}
+
+/*
+ * gc_reclaim_list: pass the objects to the reclamation function, marking
+ * the caller as reclaiming meanwhile: the objects being reclaimed are
+ * still accounted as pending, so the function staging more objects must
+ * not wait for the hard limit (see gc_pressure()).
+ */
+static void
+gc_reclaim_list(gc_t *gc, gc_entry_t *gc_list)
+{
+	void *depth = pthread_getspecific(gc->reclaim_key);
+
+	pthread_setspecific(gc->reclaim_key, (char *)depth + 1);
+	gc->reclaim(gc_list, gc->arg);
+	pthread_setspecific(gc->reclaim_key, depth);
+}
+
+/*
+ * gc_dispatch: split the list of the objects into the chunks and queue
+ * them for the helper threads.
+ *
+ * => Called without the lock, but the caller must be counted in the
+ *    helper_dispatch while the helpers are running (see gc_stop_helpers()).
+ * => Returns the remaining objects, if the jobs could not be allocated,
+ *    with their amounts; the caller reclaims them then.
+ */
+static gc_entry_t *
+gc_dispatch(gc_t *gc, gc_entry_t *gc_list, size_t *nobjs, size_t *nbytes,
+    gc_lat_t *lat)
+{
+	gc_job_t *jobs = NULL, *job;
+	unsigned njobs = 0;
+
+	while (gc_list) {
+		gc_entry_t *ent = gc_list;
+		size_t n = 1;
+
+		if ((job = malloc(sizeof(gc_job_t))) == NULL) {
+			break;
+		}
+		while (n < gc->helper_chunk && ent->next) {
+			ent = ent->next;
+			n++;
+		}
+		job->list = gc_list;
+		job->nobjs = n;
+		job->nbytes = 0;
+		job->lat = lat;
+		job->next = jobs;
+		jobs = job;
+		njobs++;
+
+		gc_list = ent->next;
+		ent->next = NULL;
+		*nobjs -= n;
+	}
+	if (jobs == NULL) {
+		return gc_list;
+	}
+
+	/*
+	 * Note: the size is accounted with the last job.
+	 */
+	jobs->nbytes = *nbytes;
+	*nbytes = 0;
+	atomic_fetch_add(&gc->helper_inflight, njobs);
+	if (lat) {
+		atomic_fetch_add(&lat->refcnt, njobs);
+	}
+
+	pthread_mutex_lock(&gc->helper_lock);
+	job = jobs;
+	while (job->next) {
+		job = job->next;
+	}
+	job->next = gc->helper_queue;
+	gc->helper_queue = jobs;
+	pthread_cond_broadcast(&gc->helper_cv);
+	pthread_mutex_unlock(&gc->helper_lock);
+	return gc_list;
+}
+
+/*
+ * gc_job_run: reclaim the chunk of the objects.
+ */
+static void
+gc_job_run(gc_t *gc, gc_job_t *job)
+{
+	gc_reclaim_list(gc, job->list);
+	gc_reclaimed(gc, job->nobjs, job->nbytes);
+	gc_lat_release(gc, job->lat);
+	free(job);
+	atomic_fetch_add(&gc->helper_inflight, -1);
+}
+
+/*
+ * gc_help: reclaim a chunk of the objects queued for the helpers, if
+ * any, in the context of the caller.
+ *
+ * => Returns true if a chunk was reclaimed.
+ */
+bool
+gc_help(gc_t *gc)
+{
+	gc_job_t *job;
+
+	if (gc->helper_queue == NULL) {
+		return false;
+	}
+	pthread_mutex_lock(&gc->helper_lock);
+	if ((job = gc->helper_queue) != NULL) {
+		gc->helper_queue = job->next;
+	}
+	pthread_mutex_unlock(&gc->helper_lock);
+
+	if (job) {
+		gc_job_run(gc, job);
+	}
+	return job != NULL;
+}
+
+/*
+ * gc_limbo_take: move the global limbo list, with its amounts and the
+ * retirement time, into the given epoch.
+ *
+ * => Must be called with the lock held.
+ */
+static void
+gc_limbo_take(gc_t *gc, unsigned epoch)
+{
+	size_t nobjs, nbytes;
+	uint64_t rtime;
+
+	gc->epoch_list[epoch] = atomic_exchange(&gc->limbo, NULL);
+	nobjs = gc->limbo_objs;
+	atomic_fetch_add(&gc->limbo_objs, -nobjs);
+	nbytes = gc->limbo_bytes;
+	atomic_fetch_add(&gc->limbo_bytes, -nbytes);
+	do {
+		rtime = gc->limbo_time;
+	} while (!atomic_compare_exchange_weak(&gc->limbo_time, rtime, 0));
+
+	/*
+	 * Note: the time could have been taken with the insertion in
+	 * progress by the previous cycle; then, account from now.
+	 */
+	gc->epoch_objs[epoch] = nobjs;
+	gc->epoch_bytes[epoch] = nbytes;
+	gc->epoch_time[epoch] = rtime ? rtime : clock_nsec();
+	gc->staged += nobjs;
+}
+
+/*
+ * gc_cycle: run a G/C cycle, reclaiming the objects which are ready.
+ *
+ * => May be called concurrently by multiple threads: if another thread
+ *    is running the cycle, then return immediately rather than block.
+ * => The objects are reclaimed without the lock held, therefore the
+ *    reclamation function may call into the G/C.
+ */
+void
+gc_cycle(gc_t *gc)
+{
+	unsigned count = EBR_EPOCHS, gc_epoch, staging_epoch;
+	gc_lat_t *lat = NULL;
+	gc_entry_t *gc_list;
+	size_t nobjs, nbytes;
+	bool dispatch;
+
+	/*
+	 * Take the ownership of the cycle; the lock protects only the
+	 * lists, so the registrations do not make the cycle give up.
+	 */
+	if (gc->cycle_busy ||
+	    !atomic_compare_exchange_weak(&gc->cycle_busy, 0, 1)) {
+		/* Another thread is running the cycle. */
+		return;
+	}
+	pthread_mutex_lock(&gc->lock);
+next:
+	/*
+	 * Call the EBR synchronisation and check whether it announces
+	 * a new epoch.
+	 */
+	if (!gc_sync(gc, &gc_epoch)) {
+		/* Not announced -- not ready to reclaim. */
+		pthread_mutex_unlock(&gc->lock);
+		atomic_store_explicit(&gc->cycle_busy, 0, memory_order_release);
+		free(lat);
+		return;
+	}
+
+	/*
+	 * Move the objects from the limbo list into the staging epoch,
+	 * together with their amounts and the retirement time.
+	 */
+	staging_epoch = gc_staging_epoch(gc);
+	ASSERT(gc->epoch_list[staging_epoch] == NULL);
+	if (gc->limbo) {
+		gc_limbo_take(gc, staging_epoch);
+	}
+
+	/*
+	 * Reclaim the objects in the G/C epoch list, including the
+	 * per-thread limbo lists of that epoch.
+	 */
+	if (lat == NULL) {
+		lat = gc_lat_alloc(gc);
+	}
+	gc_list = gc_collect(gc, gc_epoch, &nobjs, &nbytes, lat);
+	if (!gc_list && count--) {
+		/*
+		 * If there is nothing to G/C -- try a next epoch,
+		 * but loop only for one "full" cycle.
+		 */
+		goto next;
+	}
+	if (gc_list == NULL) {
+		pthread_mutex_unlock(&gc->lock);
+		atomic_store_explicit(&gc->cycle_busy, 0, memory_order_release);
+		gc_lat_release(gc, lat);
+		return;
+	}
+	if ((dispatch = gc->nhelpers && nobjs >= 2 * gc->helper_chunk)) {
+		atomic_fetch_add(&gc->helper_dispatch, 1);
+	}
+
+	/*
+	 * Reclaim the detached objects without the lock: the reclamation
+	 * function may call into the G/C (e.g. gc_register() or another
+	 * gc_limbo()) and it does not stall the registrations.  Likewise,
+	 * split them into the chunks for the helpers without the lock.
+	 */
+	atomic_fetch_add(&gc->reclaim_inflight, 1);
+	pthread_mutex_unlock(&gc->lock);
+	atomic_store_explicit(&gc->cycle_busy, 0, memory_order_release);
+
+	if (dispatch) {
+		/* The helpers will reclaim the objects (or most of them). */
+		gc_list = gc_dispatch(gc, gc_list, &nobjs, &nbytes, lat);
+		atomic_fetch_add(&gc->helper_dispatch, -1);
+	}
+	if (gc_list) {
+		gc_reclaim_list(gc, gc_list);
+		gc_reclaimed(gc, nobjs, nbytes);
+	}
+	gc_lat_release(gc, lat);
+	atomic_fetch_add(&gc->reclaim_inflight, -1);
+}
+
+/*
+ * gc_pending_p: return true if there are any objects waiting for
+ * reclamation.
+ */
+static bool
+gc_pending_p(gc_t *gc)
+{
+	bool pending = gc->limbo != NULL;
+	gc_tls_t *t;
+
+	/*
+	 * Note: check the chunks queued for the helpers and the objects
+	 * being reclaimed under the lock, since the cycle detaches them
+	 * from the lists under the lock.
+	 */
+	pthread_mutex_lock(&gc->lock);
+	pending = pending || gc->helper_inflight || gc->reclaim_inflight;
+	for (unsigned i = 0; i < EBR_EPOCHS && !pending; i++) {
+		pending = gc->epoch_list[i] != NULL;
+	}
+	LIST_FOREACH(t, &gc->list, entry) {
+		for (unsigned i = 0; i < EBR_EPOCHS && !pending; i++) {
+			pending = t->limbo[i] != NULL;
+		}
+	}
+	pthread_mutex_unlock(&gc->lock);
+	return pending;
+}
+
+void
+gc_full(gc_t *gc, unsigned msec_retry)
+{
+	const struct timespec dtime = { 0, msec_retry * 1000 * 1000 };
+	unsigned count = SPINLOCK_BACKOFF_MIN;
+again:
+	/*
+	 * Run a G/C cycle.  In the QSBR mode, the caller (if registered)
+	 * must pass the checkpoints too.
+	 */
+	gc_checkpoint(gc);
+	gc_cycle(gc);
+
+	/*
+	 * Check all epochs and the limbo lists.
+	 */
+	if (gc_pending_p(gc)) {
+		/*
+		 * There are objects waiting for reclaim.  Help the helper
+		 * threads, if any.  Otherwise, spin-wait for a little bit,
+		 * then wait for the readers holding back the epoch (EBR
+		 * only) or sleep, and try to reclaim them.
+		 */
+		if (gc_help(gc)) {
+			goto again;
+		}
+		if (count < SPINLOCK_BACKOFF_MAX) {
+			SPINLOCK_BACKOFF(count);
+		} else if (!gc->ebr || !ebr_wait(gc->ebr, msec_retry)) {
+			(void)nanosleep(&dtime, NULL);
+		}
+		goto again;
+	}
+}
+
+/*
+ * gc_worker: the background G/C thread.
+ */
+static void *
+gc_worker(void *arg)
+{
+	gc_t *gc = arg;
+
+	pthread_mutex_lock(&gc->worker_lock);
+	while (!gc->worker_stop) {
+		const unsigned period = gc->worker_period;
+		struct timespec ts;
+		bool pending;
+
+		pthread_mutex_unlock(&gc->worker_lock);
+		gc_cycle(gc);
+		pending = gc_pending_p(gc);
+		pthread_mutex_lock(&gc->worker_lock);
+
+		if (!pending) {
+			/*
+			 * Nothing to reclaim: announce that the worker is
+			 * idle and check again.  The writers check the flag
+			 * without the lock, but after staging the objects,
+			 * with a fence on both sides: either we see their
+			 * objects or they see the flag and wake us up.
+			 */
+			gc->worker_idle = true;
+			pthread_mutex_unlock(&gc->worker_lock);
+			atomic_thread_fence(memory_order_seq_cst);
+			pending = gc_pending_p(gc);
+			pthread_mutex_lock(&gc->worker_lock);
+		}
+		if (!pending) {
+			/* Sleep until the objects are staged. */
+			while (!gc->worker_stop && gc->worker_idle) {
+				pthread_cond_wait(&gc->worker_cv,
+				    &gc->worker_lock);
+			}
+			gc->worker_idle = false;
+			continue;
+		}
+		gc->worker_idle = false;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += period / 1000;
+		ts.tv_nsec += (long)(period % 1000) * 1000 * 1000;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_nsec -= 1000000000L;
+			ts.tv_sec++;
+		}
+		if (!gc->worker_stop) {
+			/* Note: a wake-up expedites the cycle. */
+			(void)pthread_cond_timedwait(&gc->worker_cv,
+			    &gc->worker_lock, &ts);
+		}
+	}
+	pthread_mutex_unlock(&gc->worker_lock);
+	return NULL;
+}
+
+/*
+ * gc_start_worker: start a background thread which runs the G/C cycles,
+ * i.e. performs the reclamation, every given period (in milliseconds)
+ * while there are objects pending reclamation.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+gc_start_worker(gc_t *gc, unsigned msec_period)
+{
+	int ret;
+
+	if (gc->worker_running) {
+		errno = EEXIST;
+		return -1;
+	}
+	gc->worker_period = msec_period ? msec_period : 1;
+	gc->worker_stop = false;
+	gc->worker_idle = false;
+
+	/* Note: set before the worker may become idle (see gc_worker()). */
+	gc->worker_running = true;
+	ret = pthread_create(&gc->worker, NULL, gc_worker, gc);
+	if (ret != 0) {
+		gc->worker_running = false;
+		errno = ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * gc_stop_worker: stop the background G/C thread, if running.
+ *
+ * => Note: the objects may still be pending reclamation; use gc_full().
+ */
+void
+gc_stop_worker(gc_t *gc)
+{
+	if (!gc->worker_running) {
+		return;
+	}
+	pthread_mutex_lock(&gc->worker_lock);
+	gc->worker_stop = true;
+	pthread_cond_signal(&gc->worker_cv);
+	pthread_mutex_unlock(&gc->worker_lock);
+
+	pthread_join(gc->worker, NULL);
+	gc->worker_running = false;
+	gc->worker_idle = false;
+}
+
+/*
+ * gc_helper: the helper thread for the parallel reclamation.
+ */
+static void *
+gc_helper(void *arg)
+{
+	gc_t *gc = arg;
+
+	pthread_mutex_lock(&gc->helper_lock);
+	for (;;) {
+		gc_job_t *job;
+
+		while (gc->helper_queue == NULL && !gc->helper_stop) {
+			pthread_cond_wait(&gc->helper_cv, &gc->helper_lock);
+		}
+		if ((job = gc->helper_queue) == NULL) {
+			/* Stopping and there is no more work. */
+			break;
+		}
+		gc->helper_queue = job->next;
+		pthread_mutex_unlock(&gc->helper_lock);
+		gc_job_run(gc, job);
+		pthread_mutex_lock(&gc->helper_lock);
+	}
+	pthread_mutex_unlock(&gc->helper_lock);
+	return NULL;
+}
+
+/*
+ * gc_start_helpers: start a pool of threads which reclaim the objects
+ * in parallel.  The lists of at least twice the chunk size (in objects;
+ * zero means the default) are split into the chunks and passed to the
+ * reclamation function concurrently, therefore it must be thread-safe.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+gc_start_helpers(gc_t *gc, unsigned nthreads, unsigned chunk)
+{
+	pthread_t *helpers;
+	unsigned i;
+	int ret;
+
+	if (gc->helpers) {
+		errno = EEXIST;
+		return -1;
+	}
+	if (nthreads == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((helpers = calloc(nthreads, sizeof(pthread_t))) == NULL) {
+		return -1;
+	}
+	pthread_mutex_init(&gc->helper_lock, NULL);
+	pthread_cond_init(&gc->helper_cv, NULL);
+	gc->helper_chunk = chunk ? chunk : GC_HELPER_CHUNK;
+	gc->helper_stop = false;
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_create(&helpers[i], NULL, gc_helper, gc);
+		if (ret != 0) {
+			break;
+		}
+	}
+	gc->helpers = helpers;
+	gc->nhelpers = i;
+	if (i < nthreads) {
+		gc_stop_helpers(gc);
+		errno = ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * gc_stop_helpers: stop the helper threads, if running.  The queued
+ * chunks are reclaimed before the threads exit.
+ */
+void
+gc_stop_helpers(gc_t *gc)
+{
+	unsigned nhelpers;
+
+	if (gc->helpers == NULL) {
+		return;
+	}
+
+	/*
+	 * No more dispatching; wait for the cycles which are already
+	 * splitting their objects to queue the chunks.
+	 */
+	pthread_mutex_lock(&gc->lock);
+	nhelpers = gc->nhelpers;
+	gc->nhelpers = 0;
+	pthread_mutex_unlock(&gc->lock);
+	while (gc->helper_dispatch) {
+		sched_yield();
+	}
+
+	pthread_mutex_lock(&gc->helper_lock);
+	gc->helper_stop = true;
+	pthread_cond_broadcast(&gc->helper_cv);
+	pthread_mutex_unlock(&gc->helper_lock);
+
+	for (unsigned i = 0; i < nhelpers; i++) {
+		pthread_join(gc->helpers[i], NULL);
+	}
+	ASSERT(gc->helper_queue == NULL);
+	pthread_cond_destroy(&gc->helper_cv);
+	pthread_mutex_destroy(&gc->helper_lock);
+	free(gc->helpers);
+	gc->helpers = NULL;
+}
+
+/*
+ * gc_get_stats: get the statistics of the G/C.
+ */
+void
+gc_get_stats(gc_t *gc, gc_stats_t *stats)
+{
+	gc_tls_t *t;
+
+	if (gc->qsbr) {
+		qsbr_stats_t qsbr_stats;
+
+		qsbr_get_stats(gc->qsbr, &qsbr_stats);
+		stats->sync_ok = qsbr_stats.sync_ok;
+		stats->sync_fail = qsbr_stats.sync_fail;
+	} else {
+		ebr_stats_t ebr_stats;
+
+		ebr_get_stats(gc->ebr, &ebr_stats);
+		stats->sync_ok = ebr_stats.sync_ok;
+		stats->sync_fail = ebr_stats.sync_fail;
+	}
+
+	pthread_mutex_lock(&gc->lock);
+	stats->nthreads = gc->nthreads;
+	stats->retired = gc->retired;
+	stats->staged = gc->staged;
+	LIST_FOREACH(t, &gc->list, entry) {
+		stats->retired += t->retired;
+		stats->staged += t->retired;
+	}
+	stats->reclaimed = gc->reclaimed;
+	memcpy(stats->latency, gc->latency, sizeof(gc->latency));
+	pthread_mutex_unlock(&gc->lock);
+
+	stats->pending = stats->retired > stats->reclaimed ?
+	    stats->retired - stats->reclaimed : 0;
+}
+
+/*
+ * gc_set_limits: set the soft and hard limits of the amount pending
+ * reclamation (in objects or, with GC_LIMIT_BYTES, in bytes).
+ *
+ * => Zero means no limit.
+ */
+void
+gc_set_limits(gc_t *gc, size_t soft, size_t hard, unsigned flags)
+{
+	ASSERT(!hard || soft <= hard);
+	gc->limit_flags = flags;
+	gc->hard_limit = hard;
+	gc->soft_limit = soft ? soft : hard;
 }
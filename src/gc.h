@@ -9,6 +9,9 @@
 #define _GC_H_
 
 #include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct gc gc_t;
 
@@ -18,19 +21,70 @@ typedef struct gc_entry {
 
 typedef void (*gc_func_t)(gc_entry_t *, void *);
 
+/*
+ * Flags for gc_create_ex().
+ */
+#define	GC_QSBR		0x01
+#define	GC_POOL		0x02
+
+/*
+ * Flags for gc_set_limits().  Note: the hard limit does not apply to
+ * the threads staging the objects in the critical path, which includes
+ * all the registered threads in the QSBR mode, or in the reclamation
+ * function; they only expedite the reclamation.  Otherwise, the callers
+ * over the hard limit are delayed for a few milliseconds at most or, with
+ * GC_LIMIT_BLOCK, block until the pending amount drops below the limit.
+ */
+#define	GC_LIMIT_BYTES	0x01
+#define	GC_LIMIT_BLOCK	0x02
+
+/*
+ * Statistics.  The latency histogram: the number of objects reclaimed
+ * with the latency (from retirement to the completion of reclamation)
+ * less than 2^i usec.
+ */
+#define	GC_LATENCY_BUCKETS	32
+
+typedef struct {
+	unsigned	nthreads;
+	uint64_t	sync_ok;
+	uint64_t	sync_fail;
+	uint64_t	retired;
+	uint64_t	staged;
+	uint64_t	reclaimed;
+	uint64_t	pending;
+	uint64_t	latency[GC_LATENCY_BUCKETS];
+} gc_stats_t;
+
 __BEGIN_DECLS
 
 gc_t *	gc_create(unsigned, gc_func_t, void *);
+gc_t *	gc_create_ex(unsigned, gc_func_t, void *, unsigned);
 void	gc_destroy(gc_t *);
-void	gc_register(gc_t *);
+int	gc_register(gc_t *);
 void	gc_unregister(gc_t *);
+bool	gc_registered_p(gc_t *);
 
 void	gc_crit_enter(gc_t *);
 void	gc_crit_exit(gc_t *);
+void	gc_checkpoint(gc_t *);
 
 void	gc_limbo(gc_t *, void *);
+void	gc_limbo_sized(gc_t *, void *, size_t);
+void	gc_limbo_chain(gc_t *, void *, void *, unsigned);
 void	gc_cycle(gc_t *);
 void	gc_full(gc_t *, unsigned);
+void	gc_set_limits(gc_t *, size_t, size_t, unsigned);
+void	gc_get_stats(gc_t *, gc_stats_t *);
+
+void *	gc_alloc(gc_t *, size_t);
+void	gc_free(gc_t *, void *);
+
+int	gc_start_worker(gc_t *, unsigned);
+void	gc_stop_worker(gc_t *);
+int	gc_start_helpers(gc_t *, unsigned, unsigned);
+void	gc_stop_helpers(gc_t *);
+bool	gc_help(gc_t *);
 
 __END_DECLS
 
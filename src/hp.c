@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Hazard pointers (HP).
+ *
+ * Reference:
+ *
+ *	M. M. Michael, Hazard Pointers: Safe Memory Reclamation for
+ *	Lock-Free Objects, IEEE Transactions on Parallel and Distributed
+ *	Systems, 15(6), 2004.
+ *
+ * Notes on the usage:
+ *
+ * Each registered thread has a fixed number of the hazard pointer slots.
+ * Before dereferencing a pointer to a shared object, the reader publishes
+ * it in one of its slots using hp_protect(), which also validates that
+ * the pointer is still reachable from the given location.  The object is
+ * then guaranteed not to be reclaimed until the slot is cleared with
+ * hp_clear() or reused.
+ *
+ * Writers remove the objects from the data structure and retire them
+ * using hp_retire().  The objects are linked into a per-thread list using
+ * the gc_entry_t structure embedded in them, as with the G/C interface.
+ * Once the number of the retired objects reaches the threshold, which
+ * is proportional to the total number of the hazard pointer slots, the
+ * list is scanned and the objects which are not protected by any of
+ * the slots are reclaimed.  Unlike EBR or QSBR, a stalled reader can
+ * hold off only the objects it protects, therefore the amount of the
+ * memory pending reclamation is bounded.
+ *
+ * The per-thread records are kept in a lock-free list, which only grows:
+ * the records are reused by the threads registering later.
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "hp.h"
+#include "utils.h"
+
+/*
+ * The minimum number of the retired objects to trigger a scan.
+ */
+#define	HP_SCAN_MIN		32
+
+struct hp_tls {
+	/*
+	 * The list of records and whether the record is used (claimed
+	 * by a thread).
+	 */
+	struct hp_tls *		next;
+	unsigned		used;
+	unsigned		nslots;
+
+	/*
+	 * The list of the retired objects (private to the thread) and
+	 * the buffer for collecting the hazard pointers during the scan.
+	 */
+	gc_entry_t *		retired;
+	unsigned		nretired;
+	void **			plist;
+	size_t			plist_size;
+
+	/*
+	 * Statistics: the number of scans and the objects retired and
+	 * reclaimed using this record.
+	 */
+	uint64_t		scans;
+	uint64_t		nretired_total;
+	uint64_t		nreclaimed;
+
+	/*
+	 * The hazard pointer slots, on their own cache line.
+	 */
+	void *			hazards[] __aligned(CACHE_LINE_SIZE);
+};
+
+struct hp {
+	/*
+	 * The list of the records and the number of records.
+	 */
+	hp_tls_t *		records;
+	unsigned		nrecords;
+
+	/*
+	 * The number of slots per thread, TLS key and the reclamation
+	 * function (see the G/C interface).
+	 */
+	unsigned		nslots;
+	pthread_key_t		tls_key;
+	unsigned		entry_off;
+	gc_func_t		reclaim;
+	void *			arg;
+
+	/*
+	 * The objects left by the threads which have unregistered.
+	 */
+	gc_entry_t *		orphans;
+};
+
+static void
+hp_default_reclaim(gc_entry_t *entry, void *arg)
+{
+	hp_t *hp = arg;
+	const unsigned off = hp->entry_off;
+	void *obj;
+
+	while (entry) {
+		obj = (void *)((uintptr_t)entry - off);
+		entry = entry->next;
+		free(obj);
+	}
+}
+
+/*
+ * hp_slot_release: clear the hazard pointers and release the record;
+ * also used as the TLS destructor.  Note: the retired objects stay with
+ * the record and will be handled by the next thread claiming it.
+ */
+static void
+hp_slot_release(void *arg)
+{
+	hp_tls_t *t = arg;
+
+	for (unsigned i = 0; i < t->nslots; i++) {
+		t->hazards[i] = NULL;
+	}
+	atomic_store_explicit(&t->used, 0, memory_order_release);
+}
+
+/*
+ * hp_create: construct a new hazard pointer domain, given the number of
+ * the slots per thread, the offset of gc_entry_t in the objects and the
+ * reclamation function (if NULL, then free(3) is used).
+ */
+hp_t *
+hp_create(unsigned nslots, unsigned off, gc_func_t reclaim, void *arg)
+{
+	hp_t *hp;
+	int ret;
+
+	ASSERT(nslots > 0);
+	ret = posix_memalign((void **)&hp, CACHE_LINE_SIZE, sizeof(hp_t));
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(hp, 0, sizeof(hp_t));
+
+	if (pthread_key_create(&hp->tls_key, hp_slot_release) != 0) {
+		free(hp);
+		return NULL;
+	}
+	hp->nslots = nslots;
+	hp->entry_off = off;
+	if (reclaim) {
+		hp->reclaim = reclaim;
+		hp->arg = arg;
+	} else {
+		hp->reclaim = hp_default_reclaim;
+		hp->arg = hp;
+	}
+	return hp;
+}
+
+void
+hp_destroy(hp_t *hp)
+{
+	hp_tls_t *t = hp->records;
+
+	/*
+	 * There are no threads left: reclaim all the objects.
+	 */
+	pthread_key_delete(hp->tls_key);
+	if (hp->orphans) {
+		hp->reclaim(hp->orphans, hp->arg);
+	}
+	while (t) {
+		hp_tls_t *next = t->next;
+
+		if (t->retired) {
+			hp->reclaim(t->retired, hp->arg);
+		}
+		free(t->plist);
+		free(t);
+		t = next;
+	}
+	free(hp);
+}
+
+/*
+ * hp_slot_claim: find a free record and claim it; if there are none,
+ * then add a new record.
+ */
+static hp_tls_t *
+hp_slot_claim(hp_t *hp)
+{
+	const size_t len = sizeof(hp_tls_t) + hp->nslots * sizeof(void *);
+	hp_tls_t *t, *head;
+	int ret;
+
+	for (t = hp->records; t; t = t->next) {
+		if (!t->used && atomic_compare_exchange_weak(&t->used, 0, 1)) {
+			return t;
+		}
+	}
+	ret = posix_memalign((void **)&t, CACHE_LINE_SIZE, len);
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(t, 0, len);
+	t->nslots = hp->nslots;
+	t->used = 1;
+
+	do {
+		head = hp->records;
+		t->next = head;
+	} while (!atomic_compare_exchange_weak(&hp->records, head, t));
+	atomic_fetch_add(&hp->nrecords, 1);
+	return t;
+}
+
+/*
+ * hp_register_h: register the current thread and return its handle,
+ * which can be passed to hp_protect_h() and hp_clear_h().
+ *
+ * => Returns NULL on failure (errno is set).
+ */
+hp_tls_t *
+hp_register_h(hp_t *hp)
+{
+	hp_tls_t *t;
+
+	t = pthread_getspecific(hp->tls_key);
+	if (__predict_false(t == NULL)) {
+		if ((t = hp_slot_claim(hp)) == NULL) {
+			return NULL;
+		}
+		pthread_setspecific(hp->tls_key, t);
+	}
+	return t;
+}
+
+/*
+ * hp_register: register the current thread.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+hp_register(hp_t *hp)
+{
+	return hp_register_h(hp) ? 0 : -1;
+}
+
+/*
+ * hp_protect_h: load the pointer from the given location and protect
+ * it using the given hazard pointer slot, given the thread handle.
+ *
+ * => Returns the protected pointer, which may be NULL.
+ */
+void *
+hp_protect_h(hp_t *hp, hp_tls_t *t, unsigned slot, void **pptr)
+{
+	void *ptr, *cur;
+
+	ASSERT(slot < hp->nslots);
+	(void)hp;
+
+	ptr = atomic_load_explicit(pptr, memory_order_relaxed);
+	for (;;) {
+		/*
+		 * Publish the hazard pointer and issue a full barrier,
+		 * so that either the scan observes it or we observe the
+		 * removal of the object on re-validation.
+		 */
+		atomic_store_explicit(&t->hazards[slot], ptr,
+		    memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+
+		cur = atomic_load_explicit(pptr, memory_order_acquire);
+		if (__predict_true(cur == ptr)) {
+			return ptr;
+		}
+		ptr = cur;
+	}
+}
+
+/*
+ * hp_clear_h: clear the hazard pointer slot, given the thread handle.
+ */
+void
+hp_clear_h(hp_t *hp, hp_tls_t *t, unsigned slot)
+{
+	ASSERT(slot < hp->nslots);
+	(void)hp;
+
+	atomic_store_explicit(&t->hazards[slot], NULL, memory_order_release);
+}
+
+void *
+hp_protect(hp_t *hp, unsigned slot, void **pptr)
+{
+	return hp_protect_h(hp, pthread_getspecific(hp->tls_key), slot, pptr);
+}
+
+void
+hp_clear(hp_t *hp, unsigned slot)
+{
+	hp_clear_h(hp, pthread_getspecific(hp->tls_key), slot);
+}
+
+static int
+hp_ptr_cmp(const void *a, const void *b)
+{
+	const uintptr_t pa = *(const uintptr_t *)a;
+	const uintptr_t pb = *(const uintptr_t *)b;
+	return (pa > pb) - (pa < pb);
+}
+
+/*
+ * hp_collect: collect all the hazard pointers into the thread buffer
+ * and sort them.
+ *
+ * => Returns the number of the pointers or -1 on failure.
+ */
+static ssize_t
+hp_collect(hp_t *hp, hp_tls_t *t)
+{
+	const unsigned nslots = hp->nslots;
+	size_t n = 0;
+
+	/*
+	 * Note: the records added after this point belong to the threads
+	 * which could not have obtained the references to the retired
+	 * objects, since these are no longer reachable.
+	 */
+	for (hp_tls_t *r = hp->records; r; r = r->next) {
+		if (n + nslots > t->plist_size) {
+			const size_t size = (t->plist_size + nslots) * 2;
+			void **plist;
+
+			plist = realloc(t->plist, size * sizeof(void *));
+			if (plist == NULL) {
+				return -1;
+			}
+			t->plist = plist;
+			t->plist_size = size;
+		}
+		for (unsigned i = 0; i < nslots; i++) {
+			void *ptr = atomic_load_explicit(&r->hazards[i],
+			    memory_order_relaxed);
+			if (ptr) {
+				t->plist[n++] = ptr;
+			}
+		}
+	}
+	qsort(t->plist, n, sizeof(void *), hp_ptr_cmp);
+	return n;
+}
+
+/*
+ * hp_scan_h: adopt the orphaned objects, scan the retired list of the
+ * thread and reclaim the objects which are not protected.
+ */
+static void
+hp_scan_h(hp_t *hp, hp_tls_t *t)
+{
+	const unsigned off = hp->entry_off;
+	gc_entry_t *ent, *kept = NULL, *gc_list = NULL;
+	unsigned nkept = 0, nobjs = 0;
+	ssize_t n;
+
+	if (hp->orphans) {
+		gc_entry_t *orphans = atomic_exchange(&hp->orphans, NULL);
+
+		while (orphans) {
+			ent = orphans;
+			orphans = ent->next;
+			ent->next = t->retired;
+			t->retired = ent;
+			t->nretired++;
+		}
+	}
+
+	/*
+	 * The objects were removed before being retired: issue a full
+	 * barrier before inspecting the hazard pointers (see the comment
+	 * in hp_protect_h()).
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	if ((n = hp_collect(hp, t)) == -1) {
+		return;
+	}
+	t->scans++;
+
+	ent = t->retired;
+	while (ent) {
+		gc_entry_t *next = ent->next;
+		void *obj = (void *)((uintptr_t)ent - off);
+
+		if (bsearch(&obj, t->plist, n, sizeof(void *), hp_ptr_cmp)) {
+			/* Protected: keep it. */
+			ent->next = kept;
+			kept = ent;
+			nkept++;
+		} else {
+			ent->next = gc_list;
+			gc_list = ent;
+			nobjs++;
+		}
+		ent = next;
+	}
+	t->retired = kept;
+	t->nretired = nkept;
+
+	if (gc_list) {
+		hp->reclaim(gc_list, hp->arg);
+		t->nreclaimed += nobjs;
+	}
+}
+
+/*
+ * hp_retire: retire the object, which must be already removed, i.e.
+ * no longer reachable by the other threads.  It will be reclaimed once
+ * it is not protected by any hazard pointer.
+ *
+ * => The current thread must be registered.
+ */
+void
+hp_retire(hp_t *hp, void *obj)
+{
+	hp_tls_t *t = pthread_getspecific(hp->tls_key);
+	gc_entry_t *ent = (void *)((uintptr_t)obj + hp->entry_off);
+	unsigned threshold;
+
+	ASSERT(t != NULL);
+	ent->next = t->retired;
+	t->retired = ent;
+	t->nretired++;
+	t->nretired_total++;
+
+	/*
+	 * Scan once the number of the retired objects reaches twice the
+	 * total number of the hazard pointers: this amortises the cost of
+	 * the scan and guarantees that at least half of the objects will
+	 * be reclaimed.
+	 */
+	threshold = 2 * hp->nrecords * hp->nslots;
+	if (threshold < HP_SCAN_MIN) {
+		threshold = HP_SCAN_MIN;
+	}
+	if (t->nretired >= threshold) {
+		hp_scan_h(hp, t);
+	}
+}
+
+/*
+ * hp_scan: scan the retired objects of the current thread and reclaim
+ * the ones which are not protected.
+ *
+ * => The current thread must be registered.
+ */
+void
+hp_scan(hp_t *hp)
+{
+	hp_tls_t *t = pthread_getspecific(hp->tls_key);
+
+	ASSERT(t != NULL);
+	hp_scan_h(hp, t);
+}
+
+/*
+ * hp_full: scan until all objects retired by the current thread (and
+ * the adopted ones) are reclaimed.
+ *
+ * => The current thread must be registered.
+ */
+void
+hp_full(hp_t *hp, unsigned msec_retry)
+{
+	const struct timespec dtime = { 0, msec_retry * 1000 * 1000 };
+	hp_tls_t *t = pthread_getspecific(hp->tls_key);
+	unsigned count = SPINLOCK_BACKOFF_MIN;
+
+	ASSERT(t != NULL);
+	for (;;) {
+		hp_scan_h(hp, t);
+		if (t->retired == NULL && hp->orphans == NULL) {
+			break;
+		}
+		if (count < SPINLOCK_BACKOFF_MAX) {
+			SPINLOCK_BACKOFF(count);
+		} else {
+			(void)nanosleep(&dtime, NULL);
+		}
+	}
+}
+
+void
+hp_unregister(hp_t *hp)
+{
+	hp_tls_t *t;
+
+	t = pthread_getspecific(hp->tls_key);
+	if (t == NULL) {
+		return;
+	}
+	pthread_setspecific(hp->tls_key, NULL);
+
+	/*
+	 * Attempt to reclaim the objects and hand over the remaining
+	 * ones; release the record (clearing the hazard pointers).
+	 */
+	hp_scan_h(hp, t);
+	if (t->retired) {
+		gc_entry_t *tail = t->retired, *head;
+
+		while (tail->next) {
+			tail = tail->next;
+		}
+		do {
+			head = hp->orphans;
+			tail->next = head;
+		} while (!atomic_compare_exchange_weak(&hp->orphans,
+		    head, t->retired));
+		t->retired = NULL;
+		t->nretired = 0;
+	}
+	hp_slot_release(t);
+}
+
+/*
+ * hp_get_stats: get the statistics of the hazard pointer domain.
+ */
+void
+hp_get_stats(hp_t *hp, hp_stats_t *stats)
+{
+	memset(stats, 0, sizeof(hp_stats_t));
+	for (hp_tls_t *t = hp->records; t; t = t->next) {
+		stats->nthreads += t->used != 0;
+		stats->scans += t->scans;
+		stats->retired += t->nretired_total;
+		stats->reclaimed += t->nreclaimed;
+	}
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+#ifndef	_HP_H_
+#define	_HP_H_
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gc.h"
+
+__BEGIN_DECLS
+
+struct hp;
+typedef struct hp hp_t;
+
+struct hp_tls;
+typedef struct hp_tls hp_tls_t;
+
+typedef struct {
+	unsigned	nthreads;
+	uint64_t	scans;
+	uint64_t	retired;
+	uint64_t	reclaimed;
+} hp_stats_t;
+
+hp_t *		hp_create(unsigned, unsigned, gc_func_t, void *);
+void		hp_destroy(hp_t *);
+int		hp_register(hp_t *);
+void		hp_unregister(hp_t *);
+
+void *		hp_protect(hp_t *, unsigned, void **);
+void		hp_clear(hp_t *, unsigned);
+void		hp_retire(hp_t *, void *);
+void		hp_scan(hp_t *);
+void		hp_full(hp_t *, unsigned);
+void		hp_get_stats(hp_t *, hp_stats_t *);
+
+hp_tls_t *	hp_register_h(hp_t *);
+void *		hp_protect_h(hp_t *, hp_tls_t *, unsigned, void **);
+void		hp_clear_h(hp_t *, hp_tls_t *, unsigned);
+
+__END_DECLS
+
+#endif
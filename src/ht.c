@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Reference RCU-style hash table on top of the G/C interface.
+ *
+ * The table maps the 64-bit keys to the values.  It is a separately
+ * chained hash table with the lock-free lookups, which run in the G/C
+ * critical path (see ht_enter() and ht_exit()), while the updates are
+ * serialised by the lock.  The updates never modify the nodes reachable
+ * by the readers, other than their linkage: the replacement of a value
+ * links a new node in place of the old one.  The unlinked nodes are
+ * staged for reclamation using gc_limbo().  Once reclaimed, the values
+ * of the removed or replaced entries are passed to the destructor, if
+ * any; therefore, a value returned by the lookup remains valid until
+ * the caller leaves the critical path.
+ *
+ * The table grows when the load factor exceeds the threshold: the new
+ * bucket array is populated with the copies of all nodes and published
+ * with a single pointer update, so the readers observe either the old
+ * or the new table in its entirety.  The old array and nodes (without
+ * their values) are staged for reclamation as a single chain.  The
+ * table does not shrink.
+ *
+ * The reclamation is driven by the users, e.g. using gc_cycle() on the
+ * G/C object of the table, see ht_gc(), or by the background G/C worker.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "ht.h"
+#include "gc.h"
+#include "utils.h"
+
+#define	HT_MIN_BUCKETS		16
+#define	HT_LOAD_FACTOR		2
+
+/*
+ * The objects staged for reclamation: the node, the stale node (copied
+ * to the new bucket array, therefore its value is still live) and the
+ * bucket array.  All of them start with the same header.
+ */
+#define	HT_NODE			0
+#define	HT_STALE		1
+#define	HT_BUCKETS		2
+
+typedef struct {
+	gc_entry_t		gc_entry;
+	unsigned		kind;
+} ht_obj_t;
+
+typedef struct ht_node {
+	ht_obj_t		hdr;
+	struct ht_node *	next;
+	uint64_t		key;
+	void *			val;
+} ht_node_t;
+
+typedef struct {
+	ht_obj_t		hdr;
+	unsigned		mask;
+	ht_node_t *		bucket[];
+} ht_buckets_t;
+
+struct ht {
+	/*
+	 * The current bucket array, read by the lookups.
+	 */
+	ht_buckets_t *		buckets;
+	gc_t *			gc;
+	ht_free_t		valfree;
+	void *			arg;
+
+	/*
+	 * The update lock and the number of the entries.
+	 */
+	pthread_mutex_t		lock __aligned(CACHE_LINE_SIZE);
+	size_t			count;
+};
+
+static inline uint64_t
+ht_hash(uint64_t x)
+{
+	/* The 64-bit finaliser of MurmurHash3. */
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static ht_buckets_t *
+ht_buckets_alloc(unsigned nbuckets)
+{
+	ht_buckets_t *b;
+
+	ASSERT((nbuckets & (nbuckets - 1)) == 0);
+	b = calloc(1, offsetof(ht_buckets_t, bucket[nbuckets]));
+	if (b == NULL) {
+		return NULL;
+	}
+	b->hdr.kind = HT_BUCKETS;
+	b->mask = nbuckets - 1;
+	return b;
+}
+
+/*
+ * ht_reclaim: the G/C reclamation function -- free the objects and
+ * destroy the values of the removed nodes.
+ */
+static void
+ht_reclaim(gc_entry_t *entry, void *arg)
+{
+	ht_t *ht = arg;
+
+	while (entry) {
+		ht_obj_t *obj = (void *)entry;
+
+		entry = entry->next;
+		if (obj->kind == HT_NODE && ht->valfree) {
+			ht->valfree(((ht_node_t *)obj)->val, ht->arg);
+		}
+		free(obj);
+	}
+}
+
+/*
+ * ht_create: construct a new hash table with the given initial number
+ * of buckets (rounded up to a power of two).  The G/C flags select the
+ * reclamation mechanism (only GC_QSBR is accepted).  The optional
+ * destructor is called for the values of the removed or replaced entries
+ * once they are no longer referenced by the readers, as well as for the
+ * remaining values on destruction.
+ *
+ * => Returns the table or NULL on failure (errno is set).
+ */
+ht_t *
+ht_create(unsigned nbuckets, unsigned flags, ht_free_t valfree, void *arg)
+{
+	unsigned n = HT_MIN_BUCKETS;
+	ht_t *ht;
+	int ret;
+
+	if (flags & ~GC_QSBR) {
+		errno = EINVAL;
+		return NULL;
+	}
+	while (n < nbuckets && n < (1U << 31)) {
+		n <<= 1;
+	}
+	ret = posix_memalign((void **)&ht, CACHE_LINE_SIZE, sizeof(ht_t));
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(ht, 0, sizeof(ht_t));
+	ht->valfree = valfree;
+	ht->arg = arg;
+
+	if ((ht->buckets = ht_buckets_alloc(n)) == NULL) {
+		goto err;
+	}
+	ht->gc = gc_create_ex(offsetof(ht_obj_t, gc_entry),
+	    ht_reclaim, ht, flags);
+	if (ht->gc == NULL) {
+		goto err;
+	}
+	pthread_mutex_init(&ht->lock, NULL);
+	return ht;
+err:
+	free(ht->buckets);
+	free(ht);
+	return NULL;
+}
+
+/*
+ * ht_destroy: reclaim all the staged objects and destroy the table,
+ * including the remaining values.  All threads must have unregistered.
+ */
+void
+ht_destroy(ht_t *ht)
+{
+	ht_buckets_t *b = ht->buckets;
+
+	gc_full(ht->gc, 1);
+	for (unsigned i = 0; i <= b->mask; i++) {
+		ht_node_t *node = b->bucket[i];
+
+		while (node) {
+			ht_node_t *next = node->next;
+
+			if (ht->valfree) {
+				ht->valfree(node->val, ht->arg);
+			}
+			free(node);
+			node = next;
+		}
+	}
+	free(b);
+	gc_destroy(ht->gc);
+	pthread_mutex_destroy(&ht->lock);
+	free(ht);
+}
+
+/*
+ * ht_register: register the current thread for the table operations.
+ *
+ * => Returns 0 on success and -1 on failure.
+ */
+int
+ht_register(ht_t *ht)
+{
+	return gc_register(ht->gc);
+}
+
+void
+ht_unregister(ht_t *ht)
+{
+	gc_unregister(ht->gc);
+}
+
+/*
+ * ht_enter: enter the critical path for the lookups.
+ */
+void
+ht_enter(ht_t *ht)
+{
+	gc_crit_enter(ht->gc);
+}
+
+/*
+ * ht_exit: exit the critical path; the values returned by the lookups
+ * must no longer be accessed.
+ */
+void
+ht_exit(ht_t *ht)
+{
+	gc_crit_exit(ht->gc);
+}
+
+/*
+ * ht_get: lookup the value by the key.
+ *
+ * => Must be called in the critical path (or, in the QSBR mode, between
+ *    the checkpoints).
+ * => Returns the value or NULL, if not found.
+ */
+void *
+ht_get(ht_t *ht, uint64_t key)
+{
+	const uint64_t hval = ht_hash(key);
+	ht_buckets_t *b;
+	ht_node_t *node;
+
+	b = atomic_load_explicit(&ht->buckets, memory_order_acquire);
+	node = atomic_load_explicit(&b->bucket[hval & b->mask],
+	    memory_order_acquire);
+	while (node) {
+		if (node->key == key) {
+			return node->val;
+		}
+		node = atomic_load_explicit(&node->next, memory_order_acquire);
+	}
+	return NULL;
+}
+
+/*
+ * ht_grow: double the number of buckets, populating the new array with
+ * the copies of the nodes.  On allocation failure, the table remains
+ * as is.
+ *
+ * => Must be called with the lock held.
+ */
+static void
+ht_grow(ht_t *ht)
+{
+	ht_buckets_t *ob = ht->buckets, *nb;
+	ht_obj_t *first = &ob->hdr, *last = &ob->hdr;
+	const unsigned nbuckets = (ob->mask + 1) * 2;
+	unsigned count = 1;
+
+	if (nbuckets == 0 || (nb = ht_buckets_alloc(nbuckets)) == NULL) {
+		return;
+	}
+	for (unsigned i = 0; i <= ob->mask; i++) {
+		for (ht_node_t *node = ob->bucket[i]; node; node = node->next) {
+			const unsigned j = ht_hash(node->key) & nb->mask;
+			ht_node_t *copy;
+
+			if ((copy = malloc(sizeof(ht_node_t))) == NULL) {
+				goto fail;
+			}
+			copy->hdr.kind = HT_NODE;
+			copy->key = node->key;
+			copy->val = node->val;
+			copy->next = nb->bucket[j];
+			nb->bucket[j] = copy;
+		}
+	}
+
+	/*
+	 * Publish the new array.  Stage the old one and its nodes, which
+	 * the readers might be traversing, as a single chain; the values
+	 * live on in the copies.
+	 */
+	atomic_store_explicit(&ht->buckets, nb, memory_order_release);
+	for (unsigned i = 0; i <= ob->mask; i++) {
+		for (ht_node_t *node = ob->bucket[i]; node; node = node->next) {
+			node->hdr.kind = HT_STALE;
+			last->gc_entry.next = &node->hdr.gc_entry;
+			last = &node->hdr;
+			count++;
+		}
+	}
+	gc_limbo_chain(ht->gc, first, last, count);
+	return;
+fail:
+	for (unsigned i = 0; i <= nb->mask; i++) {
+		ht_node_t *node = nb->bucket[i];
+
+		while (node) {
+			ht_node_t *next = node->next;
+			free(node);
+			node = next;
+		}
+	}
+	free(nb);
+}
+
+/*
+ * ht_put: insert the value or replace the existing value of the key.
+ * The replaced value is destroyed once no longer referenced.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+ht_put(ht_t *ht, uint64_t key, void *val)
+{
+	const uint64_t hval = ht_hash(key);
+	ht_node_t *node, *newnode, **pprev;
+	ht_buckets_t *b;
+
+	if ((newnode = malloc(sizeof(ht_node_t))) == NULL) {
+		return -1;
+	}
+	newnode->hdr.kind = HT_NODE;
+	newnode->key = key;
+	newnode->val = val;
+
+	pthread_mutex_lock(&ht->lock);
+	b = ht->buckets;
+	pprev = &b->bucket[hval & b->mask];
+	while ((node = *pprev) != NULL && node->key != key) {
+		pprev = &node->next;
+	}
+
+	/*
+	 * Link the new node (in place of the existing one, if any).
+	 * Its contents must be visible before it is.
+	 */
+	newnode->next = node ? node->next : *pprev;
+	atomic_store_explicit(pprev, newnode, memory_order_release);
+
+	if (node) {
+		pthread_mutex_unlock(&ht->lock);
+		gc_limbo(ht->gc, node);
+		return 0;
+	}
+	if (++ht->count > (size_t)(b->mask + 1) * HT_LOAD_FACTOR) {
+		ht_grow(ht);
+	}
+	pthread_mutex_unlock(&ht->lock);
+	return 0;
+}
+
+/*
+ * ht_del: remove the key.  The value is destroyed once no longer
+ * referenced.
+ *
+ * => Returns true if the key was found and removed.
+ */
+bool
+ht_del(ht_t *ht, uint64_t key)
+{
+	const uint64_t hval = ht_hash(key);
+	ht_node_t *node, **pprev;
+	ht_buckets_t *b;
+
+	pthread_mutex_lock(&ht->lock);
+	b = ht->buckets;
+	pprev = &b->bucket[hval & b->mask];
+	while ((node = *pprev) != NULL && node->key != key) {
+		pprev = &node->next;
+	}
+	if (node == NULL) {
+		pthread_mutex_unlock(&ht->lock);
+		return false;
+	}
+
+	/*
+	 * Unlink the node: the readers traversing it still observe the
+	 * rest of the chain.
+	 */
+	atomic_store_explicit(pprev, node->next, memory_order_relaxed);
+	ht->count--;
+	pthread_mutex_unlock(&ht->lock);
+
+	gc_limbo(ht->gc, node);
+	return true;
+}
+
+/*
+ * ht_count: return the number of the entries.
+ */
+size_t
+ht_count(ht_t *ht)
+{
+	return atomic_load_explicit(&ht->count, memory_order_relaxed);
+}
+
+/*
+ * ht_gc: return the G/C object of the table, e.g. to run the cycles,
+ * pass the checkpoints in the QSBR mode or get the statistics.
+ */
+gc_t *
+ht_gc(ht_t *ht)
+{
+	return ht->gc;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+#ifndef	_HT_H_
+#define	_HT_H_
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gc.h"
+
+__BEGIN_DECLS
+
+struct ht;
+typedef struct ht ht_t;
+
+typedef void (*ht_free_t)(void *, void *);
+
+ht_t *		ht_create(unsigned, unsigned, ht_free_t, void *);
+void		ht_destroy(ht_t *);
+int		ht_register(ht_t *);
+void		ht_unregister(ht_t *);
+
+void		ht_enter(ht_t *);
+void		ht_exit(ht_t *);
+void *		ht_get(ht_t *, uint64_t);
+
+int		ht_put(ht_t *, uint64_t, void *);
+bool		ht_del(ht_t *, uint64_t);
+size_t		ht_count(ht_t *);
+gc_t *		ht_gc(ht_t *);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,669 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Interval-based reclamation (IBR), the 2GE-IBR variant.
+ *
+ * Reference:
+ *
+ *	H. Wen, J. Izraelevitz, W. Cai, H. A. Beadle, M. L. Scott,
+ *	Interval-Based Memory Reclamation, PPoPP 2018.
+ *
+ * Notes on the usage:
+ *
+ * There is a global 64-bit epoch, which advances periodically as the
+ * objects are retired.  Each object records the epoch of its birth, see
+ * ibr_birth(), and the epoch of its retirement, see ibr_limbo().  Hence,
+ * the object has a lifetime interval [birth, retire].
+ *
+ * Readers mark the critical path, as with EBR, using ibr_enter() and
+ * ibr_exit().  On entering, the thread reserves the interval starting
+ * and ending with the current epoch.  The pointers to the shared objects
+ * must be read using ibr_read(), which extends the upper end of the
+ * interval if the epoch has advanced meanwhile.  Therefore, the reserved
+ * interval covers all the objects the reader might be referencing.
+ *
+ * The retired objects are kept in the per-thread lists.  The reclaimer
+ * frees any object whose lifetime does not overlap the interval of any
+ * thread in the critical path.  Unlike EBR, a stalled reader holds off
+ * only the objects which were born before its interval ended, i.e. the
+ * amount of the memory pending reclamation is bounded.  The cost is an
+ * additional load of the global epoch on each read of the pointer.
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "ibr.h"
+#include "utils.h"
+
+/*
+ * The reservation of a thread which is not in the critical path.
+ */
+#define	IBR_INACTIVE		((ibr_epoch_t)~0ULL)
+
+/*
+ * The number of objects retired by a thread to advance the epoch and to
+ * trigger the scan.
+ */
+#define	IBR_EPOCH_FREQ		32
+#define	IBR_SCAN_FREQ		64
+
+/*
+ * The reserved interval, as collected by the scan.  The upper end is
+ * the maximum over the intervals sorted before it (inclusive).
+ */
+typedef struct {
+	ibr_epoch_t		lower;
+	ibr_epoch_t		upper;
+} ibr_resv_t;
+
+struct ibr_tls {
+	/*
+	 * The reserved interval (or IBR_INACTIVE) and whether the slot
+	 * is used (claimed by a thread).
+	 */
+	ibr_epoch_t		lower;
+	ibr_epoch_t		upper;
+	unsigned		used;
+
+	/*
+	 * The list of the retired objects (private to the thread), on
+	 * a separate cache line, the buffer for collecting the reserved
+	 * intervals during the scan and the statistics.
+	 */
+	gc_entry_t *		retired __aligned(CACHE_LINE_SIZE);
+	unsigned		nretired;
+	ibr_resv_t *		rlist;
+	size_t			rlist_size;
+	unsigned		nsince;
+	uint64_t		scans;
+	uint64_t		nretired_total;
+	uint64_t		nreclaimed;
+} __aligned(CACHE_LINE_SIZE);
+
+/*
+ * The registered threads occupy the slots in a growable array of chunks,
+ * where each next chunk doubles in size.  See the EBR implementation for
+ * the details.
+ */
+#define	IBR_CHUNK_SLOTS		16
+#define	IBR_MAX_CHUNKS		24
+
+struct ibr {
+	/*
+	 * The global epoch, TLS key and the slot array of the registered
+	 * threads.
+	 */
+	ibr_epoch_t		global_epoch;
+	pthread_key_t		tls_key;
+	unsigned		nchunks;
+	ibr_tls_t *		chunks[IBR_MAX_CHUNKS];
+
+	/*
+	 * The entry offset and the reclamation function (see the G/C
+	 * interface), and the objects left by the unregistered threads.
+	 */
+	unsigned		entry_off;
+	gc_func_t		reclaim;
+	void *			arg;
+	gc_entry_t *		orphans;
+};
+
+static void
+ibr_default_reclaim(gc_entry_t *entry, void *arg)
+{
+	ibr_t *ibr = arg;
+	const unsigned off = ibr->entry_off;
+	void *obj;
+
+	while (entry) {
+		obj = (void *)((uintptr_t)entry - off);
+		entry = entry->next;
+		free(obj);
+	}
+}
+
+/*
+ * ibr_slot_release: release the slot; also used as the TLS destructor.
+ * Note: the retired objects stay with the slot and will be handled by
+ * the next thread claiming it.
+ */
+static void
+ibr_slot_release(void *arg)
+{
+	ibr_tls_t *t = arg;
+
+	t->lower = t->upper = IBR_INACTIVE;
+	atomic_store_explicit(&t->used, 0, memory_order_release);
+}
+
+/*
+ * ibr_create: construct a new IBR object, given the offset of the
+ * ibr_entry_t structure in the objects and the reclamation function
+ * (if NULL, then free(3) is used).
+ */
+ibr_t *
+ibr_create(unsigned off, gc_func_t reclaim, void *arg)
+{
+	ibr_t *ibr;
+	int ret;
+
+	ret = posix_memalign((void **)&ibr, CACHE_LINE_SIZE, sizeof(ibr_t));
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(ibr, 0, sizeof(ibr_t));
+
+	if (pthread_key_create(&ibr->tls_key, ibr_slot_release) != 0) {
+		free(ibr);
+		return NULL;
+	}
+	ibr->global_epoch = 1;
+	ibr->entry_off = off;
+	if (reclaim) {
+		ibr->reclaim = reclaim;
+		ibr->arg = arg;
+	} else {
+		ibr->reclaim = ibr_default_reclaim;
+		ibr->arg = ibr;
+	}
+	return ibr;
+}
+
+void
+ibr_destroy(ibr_t *ibr)
+{
+	/*
+	 * There are no threads left: reclaim all the objects.
+	 */
+	pthread_key_delete(ibr->tls_key);
+	if (ibr->orphans) {
+		ibr->reclaim(ibr->orphans, ibr->arg);
+	}
+	for (unsigned i = 0; i < ibr->nchunks; i++) {
+		const unsigned nslots = IBR_CHUNK_SLOTS << i;
+
+		for (unsigned j = 0; j < nslots; j++) {
+			ibr_tls_t *t = &ibr->chunks[i][j];
+
+			if (t->retired) {
+				ibr->reclaim(t->retired, ibr->arg);
+			}
+			free(t->rlist);
+		}
+		free(ibr->chunks[i]);
+	}
+	free(ibr);
+}
+
+/*
+ * ibr_slot_claim: find a free slot and claim it; if there are none,
+ * then add a new chunk.
+ */
+static ibr_tls_t *
+ibr_slot_claim(ibr_t *ibr)
+{
+	unsigned nchunks;
+	ibr_tls_t *chunk;
+	size_t len;
+	int ret;
+again:
+	nchunks = atomic_load_explicit(&ibr->nchunks, memory_order_acquire);
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = IBR_CHUNK_SLOTS << i;
+
+		chunk = ibr->chunks[i];
+		for (unsigned j = 0; j < nslots; j++) {
+			ibr_tls_t *t = &chunk[j];
+
+			if (!t->used &&
+			    atomic_compare_exchange_weak(&t->used, 0, 1)) {
+				return t;
+			}
+		}
+	}
+	if (nchunks == IBR_MAX_CHUNKS) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	/*
+	 * Add a new chunk, or help the racing thread to publish it.
+	 */
+	len = (IBR_CHUNK_SLOTS << nchunks) * sizeof(ibr_tls_t);
+	ret = posix_memalign((void **)&chunk, CACHE_LINE_SIZE, len);
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(chunk, 0, len);
+	for (unsigned j = 0; j < len / sizeof(ibr_tls_t); j++) {
+		chunk[j].lower = chunk[j].upper = IBR_INACTIVE;
+	}
+	if (!atomic_compare_exchange_weak(&ibr->chunks[nchunks],
+	    NULL, chunk)) {
+		free(chunk);
+	}
+	atomic_compare_exchange_weak(&ibr->nchunks, nchunks, nchunks + 1);
+	goto again;
+}
+
+/*
+ * ibr_register_h: register the current thread and return its handle,
+ * which can be passed to the *_h() functions.
+ *
+ * => Returns NULL on failure (errno is set).
+ */
+ibr_tls_t *
+ibr_register_h(ibr_t *ibr)
+{
+	ibr_tls_t *t;
+
+	t = pthread_getspecific(ibr->tls_key);
+	if (__predict_false(t == NULL)) {
+		if ((t = ibr_slot_claim(ibr)) == NULL) {
+			return NULL;
+		}
+		pthread_setspecific(ibr->tls_key, t);
+	}
+	return t;
+}
+
+/*
+ * ibr_register: register the current thread.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+ibr_register(ibr_t *ibr)
+{
+	return ibr_register_h(ibr) ? 0 : -1;
+}
+
+/*
+ * ibr_enter_h: mark the entrance to the critical path, reserving the
+ * interval of the current epoch.
+ */
+void
+ibr_enter_h(ibr_t *ibr, ibr_tls_t *t)
+{
+	const ibr_epoch_t epoch = ibr->global_epoch;
+
+	ASSERT(t->upper == IBR_INACTIVE);
+	atomic_store_explicit(&t->lower, epoch, memory_order_relaxed);
+	atomic_store_explicit(&t->upper, epoch, memory_order_relaxed);
+
+	/* Note: the reservation must be visible before any reads. */
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*
+ * ibr_exit_h: mark the exit of the critical path, releasing the interval.
+ */
+void
+ibr_exit_h(ibr_t *ibr, ibr_tls_t *t)
+{
+	(void)ibr;
+	ASSERT(t->upper != IBR_INACTIVE);
+
+	atomic_thread_fence(memory_order_seq_cst);
+	atomic_store_explicit(&t->upper, IBR_INACTIVE, memory_order_relaxed);
+	atomic_store_explicit(&t->lower, IBR_INACTIVE, memory_order_relaxed);
+}
+
+/*
+ * ibr_read_h: read the pointer to the shared object from the given
+ * location, extending the reserved interval if necessary.
+ *
+ * => Must be called in the critical path.
+ */
+void *
+ibr_read_h(ibr_t *ibr, ibr_tls_t *t, void **pptr)
+{
+	ASSERT(t->upper != IBR_INACTIVE);
+
+	for (;;) {
+		void *ptr = atomic_load_explicit(pptr, memory_order_acquire);
+		ibr_epoch_t epoch = atomic_load_explicit(&ibr->global_epoch,
+		    memory_order_relaxed);
+
+		/*
+		 * If the epoch has not advanced, then the object was
+		 * born within the reserved interval.  Otherwise, extend
+		 * the interval and re-read the pointer.
+		 */
+		if (__predict_true(epoch == t->upper)) {
+			return ptr;
+		}
+		atomic_store_explicit(&t->upper, epoch, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+	}
+}
+
+void
+ibr_enter(ibr_t *ibr)
+{
+	ibr_enter_h(ibr, pthread_getspecific(ibr->tls_key));
+}
+
+void
+ibr_exit(ibr_t *ibr)
+{
+	ibr_exit_h(ibr, pthread_getspecific(ibr->tls_key));
+}
+
+void *
+ibr_read(ibr_t *ibr, void **pptr)
+{
+	return ibr_read_h(ibr, pthread_getspecific(ibr->tls_key), pptr);
+}
+
+/*
+ * ibr_birth: record the birth epoch of the object.  It must be called
+ * after the object is allocated and before it is made globally visible.
+ */
+void
+ibr_birth(ibr_t *ibr, void *obj)
+{
+	ibr_entry_t *ent = (void *)((uintptr_t)obj + ibr->entry_off);
+	ent->birth_epoch = atomic_load_explicit(&ibr->global_epoch,
+	    memory_order_relaxed);
+}
+
+static int
+ibr_resv_cmp(const void *a, const void *b)
+{
+	const ibr_epoch_t la = ((const ibr_resv_t *)a)->lower;
+	const ibr_epoch_t lb = ((const ibr_resv_t *)b)->lower;
+	return (la > lb) - (la < lb);
+}
+
+/*
+ * ibr_collect: collect the intervals reserved by the threads in the
+ * critical path into the thread buffer, sort them by the lower end and
+ * turn the upper ends into the running maximum.
+ *
+ * => Returns the number of the intervals or -1 on failure.
+ */
+static ssize_t
+ibr_collect(ibr_t *ibr, ibr_tls_t *t)
+{
+	const unsigned nchunks = atomic_load_explicit(&ibr->nchunks,
+	    memory_order_acquire);
+	const size_t nslots = IBR_CHUNK_SLOTS * ((1UL << nchunks) - 1);
+	size_t n = 0;
+
+	/*
+	 * Note: the threads entering the critical path after this point
+	 * reserve the epochs after the retirement of the objects, which
+	 * are no longer reachable.
+	 */
+	if (nslots > t->rlist_size) {
+		ibr_resv_t *rlist;
+
+		rlist = realloc(t->rlist, nslots * sizeof(ibr_resv_t));
+		if (rlist == NULL) {
+			return -1;
+		}
+		t->rlist = rlist;
+		t->rlist_size = nslots;
+	}
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned chunk_slots = IBR_CHUNK_SLOTS << i;
+		const ibr_tls_t *chunk = ibr->chunks[i];
+
+		for (unsigned j = 0; j < chunk_slots; j++) {
+			const ibr_tls_t *ct = &chunk[j];
+			ibr_epoch_t lower, upper;
+
+			lower = atomic_load_explicit(&ct->lower,
+			    memory_order_relaxed);
+			upper = atomic_load_explicit(&ct->upper,
+			    memory_order_relaxed);
+			if (lower != IBR_INACTIVE) {
+				t->rlist[n].lower = lower;
+				t->rlist[n].upper = upper;
+				n++;
+			}
+		}
+	}
+	qsort(t->rlist, n, sizeof(ibr_resv_t), ibr_resv_cmp);
+	for (size_t i = 1; i < n; i++) {
+		if (t->rlist[i].upper < t->rlist[i - 1].upper) {
+			t->rlist[i].upper = t->rlist[i - 1].upper;
+		}
+	}
+	return n;
+}
+
+/*
+ * ibr_reserved_p: return true if the lifetime of the object overlaps
+ * any of the collected intervals: find the last interval starting at
+ * or before the retirement and check the maximum upper end up to it.
+ */
+static bool
+ibr_reserved_p(const ibr_resv_t *rlist, size_t n, const ibr_entry_t *ient)
+{
+	size_t lo = 0, hi = n;
+
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if (rlist[mid].lower <= ient->retire_epoch) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo && ient->birth_epoch <= rlist[lo - 1].upper;
+}
+
+/*
+ * ibr_scan: scan the retired objects of the thread and reclaim the ones
+ * whose lifetimes do not overlap the intervals reserved by the threads.
+ * The reservations are collected once per scan, therefore the cost is
+ * O(n log n) for n threads plus O(log n) per retired object.
+ */
+static void
+ibr_scan(ibr_t *ibr, ibr_tls_t *t)
+{
+	gc_entry_t *ent, *kept = NULL, *gc_list = NULL;
+	unsigned nkept = 0, nobjs = 0;
+	ssize_t n;
+
+	if (ibr->orphans) {
+		gc_entry_t *orphans = atomic_exchange(&ibr->orphans, NULL);
+
+		while (orphans) {
+			ent = orphans;
+			orphans = ent->next;
+			ent->next = t->retired;
+			t->retired = ent;
+			t->nretired++;
+		}
+	}
+
+	/*
+	 * The objects were removed before being retired: issue a full
+	 * barrier before inspecting the reservations.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	if ((n = ibr_collect(ibr, t)) == -1) {
+		return;
+	}
+	t->scans++;
+
+	ent = t->retired;
+	while (ent) {
+		/* Note: the G/C entry is the first member. */
+		const ibr_entry_t *ient = (const ibr_entry_t *)ent;
+		gc_entry_t *next = ent->next;
+
+		if (ibr_reserved_p(t->rlist, n, ient)) {
+			ent->next = kept;
+			kept = ent;
+			nkept++;
+		} else {
+			ent->next = gc_list;
+			gc_list = ent;
+			nobjs++;
+		}
+		ent = next;
+	}
+	t->retired = kept;
+	t->nretired = nkept;
+
+	if (gc_list) {
+		ibr->reclaim(gc_list, ibr->arg);
+		t->nreclaimed += nobjs;
+	}
+}
+
+/*
+ * ibr_limbo: retire the object, which must be already removed, i.e. no
+ * longer reachable by the other threads.
+ *
+ * => The current thread must be registered.
+ */
+void
+ibr_limbo(ibr_t *ibr, void *obj)
+{
+	ibr_tls_t *t = pthread_getspecific(ibr->tls_key);
+	ibr_entry_t *ent = (void *)((uintptr_t)obj + ibr->entry_off);
+
+	ASSERT(t != NULL);
+
+	/*
+	 * The object must be already globally invisible: ensure that
+	 * before observing the epoch.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	ent->retire_epoch = atomic_load_explicit(&ibr->global_epoch,
+	    memory_order_relaxed);
+	ent->gc_entry.next = t->retired;
+	t->retired = &ent->gc_entry;
+	t->nretired++;
+	t->nretired_total++;
+
+	/*
+	 * Periodically advance the epoch and scan the retired objects.
+	 */
+	if ((++t->nsince % IBR_EPOCH_FREQ) == 0) {
+		atomic_fetch_add(&ibr->global_epoch, 1);
+	}
+	if (t->nretired >= IBR_SCAN_FREQ) {
+		ibr_scan(ibr, t);
+	}
+}
+
+/*
+ * ibr_cycle: advance the epoch, scan the retired objects of the current
+ * thread and reclaim the ones which are no longer reserved.  The objects
+ * left by the threads which have unregistered are adopted.
+ *
+ * => The current thread must be registered.
+ */
+void
+ibr_cycle(ibr_t *ibr)
+{
+	ibr_tls_t *t = pthread_getspecific(ibr->tls_key);
+
+	ASSERT(t != NULL);
+	atomic_fetch_add(&ibr->global_epoch, 1);
+	ibr_scan(ibr, t);
+}
+
+/*
+ * ibr_full: run the cycles until all the objects retired by the current
+ * thread (and the adopted ones) are reclaimed.
+ *
+ * => The current thread must be registered and not in the critical path.
+ */
+void
+ibr_full(ibr_t *ibr, unsigned msec_retry)
+{
+	const struct timespec dtime = { 0, msec_retry * 1000 * 1000 };
+	ibr_tls_t *t = pthread_getspecific(ibr->tls_key);
+	unsigned count = SPINLOCK_BACKOFF_MIN;
+
+	ASSERT(t != NULL);
+	ASSERT(t->upper == IBR_INACTIVE);
+
+	for (;;) {
+		ibr_cycle(ibr);
+		if (t->retired == NULL && ibr->orphans == NULL) {
+			break;
+		}
+		if (count < SPINLOCK_BACKOFF_MAX) {
+			SPINLOCK_BACKOFF(count);
+		} else {
+			(void)nanosleep(&dtime, NULL);
+		}
+	}
+}
+
+void
+ibr_unregister(ibr_t *ibr)
+{
+	ibr_tls_t *t;
+
+	t = pthread_getspecific(ibr->tls_key);
+	if (t == NULL) {
+		return;
+	}
+	pthread_setspecific(ibr->tls_key, NULL);
+
+	/*
+	 * Attempt to reclaim the objects and hand over the remaining ones.
+	 */
+	ibr_scan(ibr, t);
+	if (t->retired) {
+		gc_entry_t *tail = t->retired, *head;
+
+		while (tail->next) {
+			tail = tail->next;
+		}
+		do {
+			head = ibr->orphans;
+			tail->next = head;
+		} while (!atomic_compare_exchange_weak(&ibr->orphans,
+		    head, t->retired));
+		t->retired = NULL;
+		t->nretired = 0;
+	}
+	ibr_slot_release(t);
+}
+
+/*
+ * ibr_get_stats: get the statistics of the IBR object.
+ */
+void
+ibr_get_stats(ibr_t *ibr, ibr_stats_t *stats)
+{
+	const unsigned nchunks = ibr->nchunks;
+
+	memset(stats, 0, sizeof(ibr_stats_t));
+	stats->epoch = ibr->global_epoch;
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = IBR_CHUNK_SLOTS << i;
+
+		for (unsigned j = 0; j < nslots; j++) {
+			const ibr_tls_t *t = &ibr->chunks[i][j];
+
+			stats->nthreads += t->used != 0;
+			stats->scans += t->scans;
+			stats->retired += t->nretired_total;
+			stats->reclaimed += t->nreclaimed;
+		}
+	}
+}
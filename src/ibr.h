@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+#ifndef	_IBR_H_
+#define	_IBR_H_
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gc.h"
+
+__BEGIN_DECLS
+
+struct ibr;
+typedef struct ibr ibr_t;
+
+struct ibr_tls;
+typedef struct ibr_tls ibr_tls_t;
+
+typedef uint64_t ibr_epoch_t;
+
+/*
+ * The entry to be embedded in the objects: the G/C entry (the objects
+ * are passed to the reclamation function as with the G/C interface) and
+ * the birth and retire epochs.
+ */
+typedef struct {
+	gc_entry_t	gc_entry;
+	ibr_epoch_t	birth_epoch;
+	ibr_epoch_t	retire_epoch;
+} ibr_entry_t;
+
+typedef struct {
+	unsigned	nthreads;
+	uint64_t	epoch;
+	uint64_t	scans;
+	uint64_t	retired;
+	uint64_t	reclaimed;
+} ibr_stats_t;
+
+ibr_t *		ibr_create(unsigned, gc_func_t, void *);
+void		ibr_destroy(ibr_t *);
+int		ibr_register(ibr_t *);
+void		ibr_unregister(ibr_t *);
+
+void		ibr_enter(ibr_t *);
+void		ibr_exit(ibr_t *);
+void *		ibr_read(ibr_t *, void **);
+
+void		ibr_birth(ibr_t *, void *);
+void		ibr_limbo(ibr_t *, void *);
+void		ibr_cycle(ibr_t *);
+void		ibr_full(ibr_t *, unsigned);
+void		ibr_get_stats(ibr_t *, ibr_stats_t *);
+
+ibr_tls_t *	ibr_register_h(ibr_t *);
+void		ibr_enter_h(ibr_t *, ibr_tls_t *);
+void		ibr_exit_h(ibr_t *, ibr_tls_t *);
+void *		ibr_read_h(ibr_t *, ibr_tls_t *, void **);
+
+__END_DECLS
+
+#endif
@@ -24,15 +24,61 @@
  * when qsbr_sync() returns true on a given number.
  *
  * Note that this interface is asynchronous.
+ *
+ * Threads which may block for a long time (e.g. waiting for the I/O
+ * events) without reaching a checkpoint would stall the synchronisation.
+ * Such threads can enter the extended quiescent state using the
+ * qsbr_thread_offline() function before blocking and leave it using the
+ * qsbr_thread_online() function.  The offline threads are ignored by
+ * qsbr_sync() and must not hold any references to the shared objects.
+ *
+ * Deferred callbacks:
+ *
+ * Alternatively, the writers may use qsbr_defer() to schedule a callback
+ * (e.g. freeing an object) to run after the grace period.  The callbacks
+ * are accumulated in per-thread batches and a whole batch is tagged with
+ * a single barrier epoch, which amortises the cost of qsbr_barrier().  The
+ * batches are processed when the thread passes a checkpoint: the ready
+ * batches are run and the next pending batch is closed (tagged) once the
+ * previous ones have completed.  The qsbr_poll() function can be used to
+ * close the current batch and process the callbacks explicitly.
+ *
+ * Stalled threads:
+ *
+ * Similarly to EBR, the synchronising side records the time when it
+ * first observes a thread lagging behind the barrier, together with the
+ * thread's local epoch; the thread keeping the same local epoch has not
+ * passed a checkpoint since.  See qsbr_laggards() and qsbr_set_watchdog().
+ *
+ * Notification:
+ *
+ * The writers running the event loops may request a notification, via
+ * an eventfd(2) descriptor, once all threads have observed the target
+ * epoch: see qsbr_notify_fd() and qsbr_notify_arm().  The armed target
+ * resides on the cache line of the global epoch, which the threads read
+ * on the checkpoint anyway; only if it is set, the thread which has just
+ * passed the target checks the others and, if it was the last one,
+ * signals the descriptor.  There is no barrier between the observation
+ * and the check (unless armed), therefore the last thread may miss the
+ * notification request in a race; it will signal on its next checkpoint.
+ *
+ * The checkpoint fast path is also provided as an inline function, see
+ * qsbr_inline.h, which relies on the layout of the leading members.
  */
 
-#include <sys/queue.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <pthread.h>
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
 #include "qsbr.h"
+#include "qsbr_inline.h"
 #include "utils.h"
 
 /*
@@ -41,25 +87,175 @@
  */
 static_assert(sizeof(qsbr_epoch_t) == 8, "expected 64-bit counter");
 
-typedef struct qsbr_tls {
+/*
+ * The local epoch of an offline thread: it is always ahead of any target.
+ */
+#define	QSBR_OFFLINE		((qsbr_epoch_t)~0UL)
+
+/*
+ * The batch of deferred callbacks, tagged with the barrier epoch.
+ */
+#define	QSBR_DEFER_BATCH	64
+
+typedef struct qsbr_batch {
+	qsbr_epoch_t		epoch;
+	struct qsbr_batch *	next;
+	unsigned		count;
+	struct {
+		qsbr_cb_t	fn;
+		void *		arg;
+	} cbs[QSBR_DEFER_BATCH];
+} qsbr_batch_t;
+
+struct qsbr_tls {
 	/*
-	 * The thread (local) epoch, observed at qsbr_checkpoint().
-	 * Also, a pointer to the TLS structure of a next thread.
+	 * The thread (local) epoch, observed at qsbr_checkpoint(),
+	 * or QSBR_OFFLINE if the thread is offline.  Also, whether
+	 * the slot is used (claimed by a thread).
 	 */
 	qsbr_epoch_t		local_epoch;
-	LIST_ENTRY(qsbr_tls)	entry;
-} qsbr_tls_t;
+
+	/*
+	 * Deferred callbacks: the batch being filled and the list of
+	 * the closed batches, waiting for their epochs.  Note: they
+	 * follow the local epoch, see qsbr_inline.h.
+	 */
+	qsbr_batch_t *		defer_open;
+	qsbr_batch_t *		defer_list;
+	unsigned		used;
+
+	/*
+	 * The QSBR object (for the TLS destructor).  Also, the slot which
+	 * held back the pending batches at the last scan and the oldest
+	 * epoch the batches wait for, see qsbr_defer_process().
+	 */
+	qsbr_t *		qs;
+	const struct qsbr_tls *	defer_laggard;
+	qsbr_epoch_t		defer_wait;
+
+	/*
+	 * Statistics: successful and failed qsbr_sync() calls.
+	 */
+	uint64_t		sync_ok;
+	uint64_t		sync_fail;
+
+	/*
+	 * The notification target the thread has last checked.
+	 */
+	qsbr_epoch_t		notify_seen;
+
+	/*
+	 * The stall: the local epoch (plus one) the thread was first
+	 * observed lagging with, the time of that and whether the
+	 * watchdog fired.  Written by the synchronising side.  Also,
+	 * the label.
+	 */
+	qsbr_epoch_t		stall_epoch;
+	uint64_t		stall_time;
+	unsigned		stall_reported;
+	char			label[QSBR_LABEL_LEN];
+} __aligned(CACHE_LINE_SIZE);
+
+/*
+ * The registered threads occupy the slots in a growable array of chunks,
+ * where each next chunk doubles in size.  See the EBR implementation for
+ * the details.
+ */
+#define	QSBR_CHUNK_SLOTS	16
+#define	QSBR_MAX_CHUNKS		24
 
 struct qsbr {
 	/*
-	 * The global epoch, TLS key with a list of the registered threads.
+	 * The global epoch, the armed notification target (or zero), TLS
+	 * key and the slot array of the registered threads.
 	 */
 	qsbr_epoch_t		global_epoch;
+	qsbr_epoch_t		notify_target;
 	pthread_key_t		tls_key;
-	pthread_mutex_t		lock;
-	LIST_HEAD(, qsbr_tls)	list;
+	unsigned		nchunks;
+	qsbr_tls_t *		chunks[QSBR_MAX_CHUNKS];
+
+	/*
+	 * Statistics: the counters inherited from the threads which
+	 * have unregistered and the counters of qsbr_observed_p().
+	 */
+	uint64_t		sync_ok __aligned(CACHE_LINE_SIZE);
+	uint64_t		sync_fail;
+
+	/*
+	 * The batches of the deferred callbacks left by the threads
+	 * which have unregistered.  Adopted by qsbr_poll().
+	 */
+	qsbr_batch_t *		orphans;
+
+	/*
+	 * The watchdog: the callback, its argument and the threshold.
+	 */
+	qsbr_watchdog_t		watchdog;
+	void *			watchdog_arg;
+	uint64_t		watchdog_nsec;
+
+	/*
+	 * The notification descriptor or -1, if not created.
+	 */
+	int			notify_fd;
 };
 
+/*
+ * The layout published to the inline fast path.
+ */
+static_assert(offsetof(struct qsbr, global_epoch) ==
+    offsetof(qsbr_pub_t, global_epoch), "qsbr_pub_t::global_epoch");
+static_assert(offsetof(struct qsbr, notify_target) ==
+    offsetof(qsbr_pub_t, notify_target), "qsbr_pub_t::notify_target");
+static_assert(offsetof(struct qsbr_tls, local_epoch) ==
+    offsetof(qsbr_tls_pub_t, local_epoch), "qsbr_tls_pub_t::local_epoch");
+static_assert(offsetof(struct qsbr_tls, defer_open) ==
+    offsetof(qsbr_tls_pub_t, defer_open), "qsbr_tls_pub_t::defer_open");
+static_assert(offsetof(struct qsbr_tls, defer_list) ==
+    offsetof(qsbr_tls_pub_t, defer_list), "qsbr_tls_pub_t::defer_list");
+
+static void	qsbr_notify_check(qsbr_t *);
+static void	qsbr_notify_checkpoint(qsbr_t *, qsbr_tls_t *);
+static void	qsbr_defer_close(qsbr_t *, qsbr_tls_t *);
+
+/*
+ * qsbr_slot_release: hand over the pending deferred callbacks and the
+ * statistics, then release the slot; also used as the TLS destructor.
+ */
+static void
+qsbr_slot_release(void *arg)
+{
+	qsbr_tls_t *t = arg;
+	qsbr_t *qs = t->qs;
+
+	qsbr_defer_close(qs, t);
+	if (t->defer_list) {
+		qsbr_batch_t *tail = t->defer_list, *head;
+
+		while (tail->next) {
+			tail = tail->next;
+		}
+		do {
+			head = qs->orphans;
+			tail->next = head;
+		} while (!atomic_compare_exchange_weak(&qs->orphans,
+		    head, t->defer_list));
+		t->defer_list = NULL;
+	}
+	t->defer_laggard = NULL;
+
+	atomic_fetch_add(&qs->sync_ok, t->sync_ok);
+	atomic_fetch_add(&qs->sync_fail, t->sync_fail);
+	atomic_store_explicit(&t->used, 0, memory_order_release);
+
+	/* The thread might have been the last one lagging behind. */
+	if (__predict_false(qs->notify_target)) {
+		atomic_thread_fence(memory_order_seq_cst);
+		qsbr_notify_check(qs);
+	}
+}
+
 qsbr_t *
 qsbr_create(void)
 {
@@ -73,51 +269,309 @@ qsbr_create(void)
 	}
 	memset(qs, 0, sizeof(qsbr_t));
 
-	if (pthread_key_create(&qs->tls_key, free) != 0) {
+	if (pthread_key_create(&qs->tls_key, qsbr_slot_release) != 0) {
 		free(qs);
 		return NULL;
 	}
-	pthread_mutex_init(&qs->lock, NULL);
 	qs->global_epoch = 1;
+	qs->notify_fd = -1;
 	return qs;
 }
 
+/*
+ * qsbr_batch_run: run the callbacks of all batches in the list and
+ * destroy them.
+ */
+static void
+qsbr_batch_run(qsbr_batch_t *batch)
+{
+	while (batch) {
+		qsbr_batch_t *next = batch->next;
+
+		for (unsigned i = 0; i < batch->count; i++) {
+			batch->cbs[i].fn(batch->cbs[i].arg);
+		}
+		free(batch);
+		batch = next;
+	}
+}
+
 void
 qsbr_destroy(qsbr_t *qs)
 {
 	pthread_key_delete(qs->tls_key);
-	pthread_mutex_destroy(&qs->lock);
+
+	/*
+	 * There are no threads left: all deferred callbacks are safe
+	 * to run now.  Note: the threads which are still registered
+	 * might carry the batches.
+	 */
+	qsbr_batch_run(qs->orphans);
+	for (unsigned i = 0; i < qs->nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+
+		for (unsigned j = 0; j < nslots; j++) {
+			qsbr_tls_t *t = &qs->chunks[i][j];
+
+			qsbr_batch_run(t->defer_list);
+			qsbr_batch_run(t->defer_open);
+		}
+		free(qs->chunks[i]);
+	}
+	if (qs->notify_fd != -1) {
+		close(qs->notify_fd);
+	}
 	free(qs);
 }
 
 /*
- * qsbr_register: register the current thread for QSBR.
+ * qsbr_slot_claim: find a free slot and claim it; if there are none,
+ * then add a new chunk.
  */
-int
-qsbr_register(qsbr_t *qs)
+static qsbr_tls_t *
+qsbr_slot_claim(qsbr_t *qs)
+{
+	unsigned nchunks;
+	qsbr_tls_t *chunk;
+	size_t len;
+	int ret;
+again:
+	nchunks = atomic_load_explicit(&qs->nchunks, memory_order_acquire);
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+
+		chunk = qs->chunks[i];
+		for (unsigned j = 0; j < nslots; j++) {
+			qsbr_tls_t *t = &chunk[j];
+
+			if (!t->used &&
+			    atomic_compare_exchange_weak(&t->used, 0, 1)) {
+				return t;
+			}
+		}
+	}
+	if (nchunks == QSBR_MAX_CHUNKS) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	/*
+	 * Add a new chunk, or help the racing thread to publish it.
+	 */
+	len = (QSBR_CHUNK_SLOTS << nchunks) * sizeof(qsbr_tls_t);
+	ret = posix_memalign((void **)&chunk, CACHE_LINE_SIZE, len);
+	if (ret != 0) {
+		errno = ret;
+		return NULL;
+	}
+	memset(chunk, 0, len);
+	if (!atomic_compare_exchange_weak(&qs->chunks[nchunks], NULL, chunk)) {
+		free(chunk);
+	}
+	atomic_compare_exchange_weak(&qs->nchunks, nchunks, nchunks + 1);
+	goto again;
+}
+
+/*
+ * qsbr_register_h: register the current thread for QSBR and return
+ * its handle, which can be passed to qsbr_checkpoint_h().
+ *
+ * => Returns NULL on failure (errno is set).
+ */
+qsbr_tls_t *
+qsbr_register_h(qsbr_t *qs)
 {
 	qsbr_tls_t *t;
 
 	t = pthread_getspecific(qs->tls_key);
 	if (__predict_false(t == NULL)) {
-		int ret;
+		if ((t = qsbr_slot_claim(qs)) == NULL) {
+			return NULL;
+		}
+		/* The previous owner has handed over its callbacks. */
+		ASSERT(t->defer_open == NULL && t->defer_list == NULL);
+		t->qs = qs;
+		t->local_epoch = 0;
+		t->sync_ok = t->sync_fail = 0;
+		t->stall_epoch = 0;
+		t->notify_seen = 0;
+		memset(t->label, 0, sizeof(t->label));
+		pthread_setspecific(qs->tls_key, t);
+	}
+	return t;
+}
+
+/*
+ * qsbr_register: register the current thread for QSBR.
+ */
+int
+qsbr_register(qsbr_t *qs)
+{
+	return qsbr_register_h(qs) ? 0 : -1;
+}
+
+/*
+ * qsbr_registered_p: return true if the current thread is registered.
+ */
+bool
+qsbr_registered_p(qsbr_t *qs)
+{
+	return pthread_getspecific(qs->tls_key) != NULL;
+}
+
+/*
+ * qsbr_defer_close: close the batch being filled, tagging it with a new
+ * barrier epoch, and put it on the list of the pending batches.
+ */
+static void
+qsbr_defer_close(qsbr_t *qs, qsbr_tls_t *t)
+{
+	qsbr_batch_t *batch = t->defer_open;
+
+	if (batch) {
+		batch->epoch = qsbr_barrier(qs);
+		batch->next = t->defer_list;
+		t->defer_list = batch;
+		t->defer_open = NULL;
+	}
+}
+
+/*
+ * qsbr_defer_process: run the batches whose epochs were observed by all
+ * the threads; close the batch being filled if nothing else is pending.
+ */
+static void
+qsbr_defer_process(qsbr_t *qs, qsbr_tls_t *t)
+{
+	const qsbr_tls_t *laggard = t->defer_laggard;
+	qsbr_batch_t *ready = NULL, **prevp;
+	qsbr_epoch_t min_epoch;
+	unsigned nchunks;
+
+	/*
+	 * The oldest observed epoch can only move once the thread which
+	 * held back the pending batches at the last scan passes the
+	 * checkpoint (or goes offline or unregisters): until then, there
+	 * is no need to rescan all the slots.
+	 */
+	if (laggard && laggard->used && laggard->local_epoch < t->defer_wait) {
+		return;
+	}
+
+	/*
+	 * Find the oldest epoch observed by the threads.  Note: the
+	 * offline threads are always ahead.
+	 */
+	min_epoch = QSBR_OFFLINE;
+	laggard = NULL;
+	nchunks = atomic_load_explicit(&qs->nchunks, memory_order_acquire);
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+		const qsbr_tls_t *chunk = qs->chunks[i];
 
-		ret = posix_memalign((void **)&t,
-		    CACHE_LINE_SIZE, sizeof(qsbr_tls_t));
-		if (ret != 0) {
-			errno = ret;
+		for (unsigned j = 0; j < nslots; j++) {
+			const qsbr_tls_t *ct = &chunk[j];
+
+			if (ct->used && ct->local_epoch < min_epoch) {
+				min_epoch = ct->local_epoch;
+				laggard = ct;
+			}
+		}
+	}
+
+	/*
+	 * Detach the ready batches.  Note: the callbacks may defer more.
+	 */
+	prevp = &t->defer_list;
+	while (*prevp) {
+		qsbr_batch_t *batch = *prevp;
+
+		if (batch->epoch <= min_epoch) {
+			*prevp = batch->next;
+			batch->next = ready;
+			ready = batch;
+			continue;
+		}
+		prevp = &batch->next;
+	}
+	if (t->defer_list == NULL) {
+		qsbr_defer_close(qs, t);
+	}
+
+	/*
+	 * Remember what holds back the remaining batches.
+	 */
+	t->defer_laggard = t->defer_list ? laggard : NULL;
+	t->defer_wait = QSBR_OFFLINE;
+	for (qsbr_batch_t *b = t->defer_list; b; b = b->next) {
+		if (b->epoch < t->defer_wait) {
+			t->defer_wait = b->epoch;
+		}
+	}
+	qsbr_batch_run(ready);
+}
+
+/*
+ * qsbr_defer: schedule the callback to be run once all the threads pass
+ * the grace period.  The current thread must be registered.
+ *
+ * => Returns 0 on success and -1 on failure (errno is set).
+ */
+int
+qsbr_defer(qsbr_t *qs, qsbr_cb_t fn, void *arg)
+{
+	qsbr_tls_t *t = pthread_getspecific(qs->tls_key);
+	qsbr_batch_t *batch;
+
+	ASSERT(t != NULL);
+	if ((batch = t->defer_open) == NULL) {
+		if ((batch = malloc(sizeof(qsbr_batch_t))) == NULL) {
 			return -1;
 		}
-		pthread_setspecific(qs->tls_key, t);
+		batch->count = 0;
+		t->defer_open = batch;
 	}
-	memset(t, 0, sizeof(qsbr_tls_t));
+	batch->cbs[batch->count].fn = fn;
+	batch->cbs[batch->count].arg = arg;
 
-	pthread_mutex_lock(&qs->lock);
-	LIST_INSERT_HEAD(&qs->list, t, entry);
-	pthread_mutex_unlock(&qs->lock);
+	if (++batch->count == QSBR_DEFER_BATCH) {
+		qsbr_defer_close(qs, t);
+	}
 	return 0;
 }
 
+/*
+ * qsbr_poll: close the current batch of the deferred callbacks, pass
+ * the checkpoint and run the ready callbacks.  Also, adopt the callbacks
+ * left by the threads which have unregistered.
+ *
+ * => Returns true if there are no more pending callbacks.
+ */
+bool
+qsbr_poll(qsbr_t *qs)
+{
+	qsbr_tls_t *t = pthread_getspecific(qs->tls_key);
+	qsbr_batch_t *orphans;
+
+	ASSERT(t != NULL);
+	if (qs->orphans &&
+	    (orphans = atomic_exchange(&qs->orphans, NULL)) != NULL) {
+		qsbr_batch_t *tail = orphans;
+
+		while (tail->next) {
+			tail = tail->next;
+		}
+		tail->next = t->defer_list;
+		t->defer_list = orphans;
+
+		/* The adopted batches may be older: rescan. */
+		t->defer_laggard = NULL;
+	}
+	qsbr_defer_close(qs, t);
+	qsbr_checkpoint_h(qs, t);
+	return t->defer_open == NULL && t->defer_list == NULL;
+}
+
 void
 qsbr_unregister(qsbr_t *qsbr)
 {
@@ -128,23 +582,18 @@ qsbr_unregister(qsbr_t *qsbr)
 		return;
 	}
 	pthread_setspecific(qsbr->tls_key, NULL);
-
-	pthread_mutex_lock(&qsbr->lock);
-	LIST_REMOVE(t, entry);
-	pthread_mutex_unlock(&qsbr->lock);
-	free(t);
+	qsbr_slot_release(t);
 }
 
 /*
- * qsbr_checkpoint: indicate a quiescent state of the current thread.
+ * qsbr_checkpoint_h: indicate a quiescent state of the thread, given
+ * its handle.
  */
 void
-qsbr_checkpoint(qsbr_t *qs)
+qsbr_checkpoint_h(qsbr_t *qs, qsbr_tls_t *t)
 {
-	qsbr_tls_t *t;
-
-	t = pthread_getspecific(qs->tls_key);
 	ASSERT(t != NULL);
+	ASSERT(t->local_epoch != QSBR_OFFLINE);
 
 	/*
 	 * Observe the current epoch and issue a load barrier.
@@ -155,6 +604,91 @@ qsbr_checkpoint(qsbr_t *qs)
 	 */
 	atomic_thread_fence(memory_order_seq_cst);
 	t->local_epoch = qs->global_epoch;
+
+	if (__predict_false(qs->notify_target ||
+	    t->defer_list || t->defer_open)) {
+		qsbr_checkpoint_slow(qs, t);
+	}
+}
+
+/*
+ * qsbr_checkpoint_slow: the slow path of the checkpoint -- check the
+ * notification and process the deferred callbacks.
+ */
+void
+qsbr_checkpoint_slow(qsbr_t *qs, qsbr_tls_t *t)
+{
+	if (qs->notify_target) {
+		qsbr_notify_checkpoint(qs, t);
+	}
+	if (t->defer_list || t->defer_open) {
+		qsbr_defer_process(qs, t);
+	}
+}
+
+/*
+ * qsbr_checkpoint: indicate a quiescent state of the current thread.
+ */
+void
+qsbr_checkpoint(qsbr_t *qs)
+{
+	qsbr_checkpoint_h(qs, pthread_getspecific(qs->tls_key));
+}
+
+/*
+ * qsbr_thread_offline_h: put the thread into the extended quiescent
+ * state, given its handle.  The thread must not hold any references to
+ * the shared objects until it comes back online.
+ */
+void
+qsbr_thread_offline_h(qsbr_t *qs, qsbr_tls_t *t)
+{
+	ASSERT(t != NULL);
+
+	/*
+	 * Ensure that all the accesses to the shared objects are
+	 * globally visible before the thread is seen as offline.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	atomic_store_explicit(&t->local_epoch, QSBR_OFFLINE,
+	    memory_order_relaxed);
+
+	/* The thread might have been the last one lagging behind. */
+	if (__predict_false(qs->notify_target)) {
+		atomic_thread_fence(memory_order_seq_cst);
+		qsbr_notify_check(qs);
+	}
+}
+
+/*
+ * qsbr_thread_online_h: bring the thread back online, given its handle.
+ */
+void
+qsbr_thread_online_h(qsbr_t *qs, qsbr_tls_t *t)
+{
+	ASSERT(t != NULL);
+	ASSERT(t->local_epoch == QSBR_OFFLINE);
+
+	/*
+	 * Observe the current epoch and issue a full barrier, so that
+	 * the observation is globally visible before any accesses to
+	 * the shared objects.
+	 */
+	atomic_store_explicit(&t->local_epoch, qs->global_epoch,
+	    memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+void
+qsbr_thread_offline(qsbr_t *qs)
+{
+	qsbr_thread_offline_h(qs, pthread_getspecific(qs->tls_key));
+}
+
+void
+qsbr_thread_online(qsbr_t *qs)
+{
+	qsbr_thread_online_h(qs, pthread_getspecific(qs->tls_key));
 }
 
 qsbr_epoch_t
@@ -164,26 +698,369 @@ qsbr_barrier(qsbr_t *qs)
 	return atomic_fetch_add(&qs->global_epoch, 1) + 1;
 }
 
+/*
+ * qsbr_scan: return true if all registered threads have observed the
+ * target epoch.  Note: the offline threads are always ahead.
+ *
+ * => Otherwise, return the thread lagging behind.
+ */
+static bool
+qsbr_scan(qsbr_t *qs, qsbr_epoch_t target, qsbr_tls_t **laggard)
+{
+	const unsigned nchunks =
+	    atomic_load_explicit(&qs->nchunks, memory_order_acquire);
+
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+		qsbr_tls_t *chunk = qs->chunks[i];
+
+		for (unsigned j = 0; j < nslots; j++) {
+			qsbr_tls_t *t = &chunk[j];
+
+			if (t->used && t->local_epoch < target) {
+				*laggard = t;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * qsbr_notify_check: if the armed target has been observed by all
+ * threads, then disarm it and signal the notification descriptor.
+ */
+static void
+qsbr_notify_check(qsbr_t *qs)
+{
+	const qsbr_epoch_t target =
+	    atomic_load_explicit(&qs->notify_target, memory_order_relaxed);
+	qsbr_tls_t *laggard;
+
+	if (target == 0 || !qsbr_scan(qs, target, &laggard)) {
+		return;
+	}
+	if (atomic_compare_exchange_weak(&qs->notify_target, target, 0)) {
+#if defined(__linux__)
+		(void)eventfd_write(qs->notify_fd, 1);
+#endif
+	}
+}
+
+/*
+ * qsbr_notify_checkpoint: the checkpoint with the notification armed;
+ * if the thread has just observed the target, check the others.
+ */
+static void
+qsbr_notify_checkpoint(qsbr_t *qs, qsbr_tls_t *t)
+{
+	const qsbr_epoch_t target =
+	    atomic_load_explicit(&qs->notify_target, memory_order_relaxed);
+
+	if (target == 0 || t->notify_seen == target ||
+	    t->local_epoch < target) {
+		return;
+	}
+	t->notify_seen = target;
+
+	/*
+	 * Make our observation visible before checking the others:
+	 * if the threads pass the target concurrently, at least one
+	 * of them will see the rest.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	qsbr_notify_check(qs);
+}
+
+/*
+ * qsbr_notify_fd: return the notification descriptor of the QSBR object,
+ * creating it on the first call.  It becomes readable once the target
+ * epoch, requested using qsbr_notify_arm(), is observed by all threads.
+ * The descriptor is owned by the QSBR object; the caller should read it
+ * (8 bytes) to reset the readiness.
+ *
+ * => Returns -1 on failure (errno is set); not supported on non-Linux.
+ */
+int
+qsbr_notify_fd(qsbr_t *qs)
+{
+#if defined(__linux__)
+	int fd;
+
+	if (qs->notify_fd != -1) {
+		return qs->notify_fd;
+	}
+	if ((fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		return -1;
+	}
+	if (!atomic_compare_exchange_weak(&qs->notify_fd, -1, fd)) {
+		/* Lost the race. */
+		close(fd);
+	}
+	return qs->notify_fd;
+#else
+	(void)qs;
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+/*
+ * qsbr_notify_arm: request the notification once all threads observe
+ * the target epoch (returned by qsbr_barrier()).  The notification is
+ * one-shot: there is a single armed target -- the lowest requested --
+ * so, once notified, the caller should re-arm for any remaining targets.
+ *
+ * => Returns true if the target has already been observed (and the
+ *    descriptor signalled).
+ */
+bool
+qsbr_notify_arm(qsbr_t *qs, qsbr_epoch_t target)
+{
+	qsbr_tls_t *laggard;
+	qsbr_epoch_t cur;
+
+	ASSERT(qs->notify_fd != -1);
+	ASSERT(target != 0);
+
+	do {
+		cur = qs->notify_target;
+		if (cur && cur <= target) {
+			break;
+		}
+	} while (!atomic_compare_exchange_weak(&qs->notify_target,
+	    cur, target));
+
+	/*
+	 * Publish the request before checking the threads.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (!qsbr_scan(qs, target, &laggard)) {
+		return false;
+	}
+	qsbr_notify_check(qs);
+	return true;
+}
+
+/*
+ * qsbr_stall_note: record the stall of the lagging thread, given its
+ * local epoch, unless already recorded.
+ *
+ * => Returns the time when the stall was first observed.
+ */
+static uint64_t
+qsbr_stall_note(qsbr_tls_t *t, qsbr_epoch_t local_epoch, uint64_t *now)
+{
+	/* Note: zero means no stall recorded. */
+	const qsbr_epoch_t key = local_epoch + 1;
+
+	if (atomic_load_explicit(&t->stall_epoch,
+	    memory_order_relaxed) != key) {
+		if (*now == 0) {
+			*now = clock_nsec();
+		}
+		atomic_store_explicit(&t->stall_time, *now,
+		    memory_order_relaxed);
+		atomic_store_explicit(&t->stall_reported, 0,
+		    memory_order_relaxed);
+		atomic_store_explicit(&t->stall_epoch, key,
+		    memory_order_relaxed);
+	}
+	return atomic_load_explicit(&t->stall_time, memory_order_relaxed);
+}
+
+/*
+ * qsbr_laggards_scan: find the threads lagging behind the last barrier,
+ * record their stalls and fill in up to the given number of the entries.
+ * If requested, fire the watchdog for the stalls exceeding the threshold.
+ *
+ * => Returns the number of the lagging threads.
+ */
+static unsigned
+qsbr_laggards_scan(qsbr_t *qs, qsbr_laggard_t *lags, unsigned max,
+    bool fire)
+{
+	const qsbr_epoch_t target =
+	    atomic_load_explicit(&qs->global_epoch, memory_order_acquire);
+	const unsigned nchunks =
+	    atomic_load_explicit(&qs->nchunks, memory_order_acquire);
+	unsigned count = 0;
+	uint64_t now = 0;
+
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+		qsbr_tls_t *chunk = qs->chunks[i];
+
+		for (unsigned j = 0; j < nslots; j++) {
+			qsbr_tls_t *t = &chunk[j];
+			qsbr_epoch_t local_epoch;
+			qsbr_laggard_t lag;
+
+			local_epoch = atomic_load_explicit(&t->local_epoch,
+			    memory_order_relaxed);
+			if (!t->used || local_epoch >= target) {
+				continue;
+			}
+			if (now == 0) {
+				now = clock_nsec();
+			}
+			lag.stall_nsec = qsbr_stall_note(t, local_epoch, &now);
+			lag.stall_nsec = now > lag.stall_nsec ?
+			    now - lag.stall_nsec : 0;
+			memcpy(lag.label, t->label, QSBR_LABEL_LEN);
+			lag.label[QSBR_LABEL_LEN - 1] = '\0';
+
+			if (count < max) {
+				lags[count] = lag;
+			}
+			count++;
+
+			if (fire && lag.stall_nsec >= qs->watchdog_nsec &&
+			    !t->stall_reported) {
+				t->stall_reported = 1;
+				qs->watchdog(&lag, qs->watchdog_arg);
+			}
+		}
+	}
+	return count;
+}
+
+/*
+ * qsbr_stalled: record the stall of the lagging thread, if known, or,
+ * if the watchdog is set, check all threads.
+ */
+static void
+qsbr_stalled(qsbr_t *qs, qsbr_tls_t *laggard)
+{
+	uint64_t now = 0;
+
+	if (__predict_false(qs->watchdog)) {
+		(void)qsbr_laggards_scan(qs, NULL, 0, true);
+		return;
+	}
+	(void)qsbr_stall_note(laggard, laggard->local_epoch, &now);
+}
+
+/*
+ * qsbr_laggards: get the threads which have not passed a checkpoint
+ * since the last barrier.  The stall time is measured from the moment
+ * the thread was first observed lagging (by qsbr_sync(), qsbr_observed_p()
+ * or this function), therefore it is a lower bound.
+ *
+ * => Fills in up to the given number of the entries.
+ * => Returns the number of the lagging threads.
+ */
+unsigned
+qsbr_laggards(qsbr_t *qs, qsbr_laggard_t *lags, unsigned max)
+{
+	return qsbr_laggards_scan(qs, lags, max, false);
+}
+
+/*
+ * qsbr_set_label: set the label of the current thread, which identifies
+ * it in the laggard reports.  The label is truncated, if too long.
+ */
+void
+qsbr_set_label(qsbr_t *qs, const char *label)
+{
+	qsbr_tls_t *t = pthread_getspecific(qs->tls_key);
+
+	ASSERT(t != NULL);
+	strncpy(t->label, label, QSBR_LABEL_LEN - 1);
+	t->label[QSBR_LABEL_LEN - 1] = '\0';
+}
+
+/*
+ * qsbr_set_watchdog: set the callback, which is called (by qsbr_sync()
+ * or qsbr_observed_p(), at most once per stall) when a thread lags behind
+ * the barrier for longer than the threshold.  Must be set before the
+ * synchronisation is performed.  NULL function disables the watchdog.
+ *
+ * => Note: the watchdog adds a sweep of all slots on every unsuccessful
+ *    synchronisation attempt.
+ */
+void
+qsbr_set_watchdog(qsbr_t *qs, unsigned msec, qsbr_watchdog_t fn, void *arg)
+{
+	qs->watchdog_nsec = (uint64_t)msec * 1000000;
+	qs->watchdog_arg = arg;
+	qs->watchdog = fn;
+}
+
 bool
 qsbr_sync(qsbr_t *qs, qsbr_epoch_t target)
 {
-	qsbr_tls_t *t;
+	qsbr_tls_t *self, *laggard;
 
 	/*
-	 * First, our thread should observe the epoch itself.
+	 * First, our thread should observe the epoch itself
+	 * (unless it is offline, in which case it is ignored).
 	 */
-	qsbr_checkpoint(qs);
+	self = pthread_getspecific(qs->tls_key);
+	if (self->local_epoch != QSBR_OFFLINE) {
+		qsbr_checkpoint_h(qs, self);
+	} else {
+		atomic_thread_fence(memory_order_seq_cst);
+	}
 
 	/*
 	 * Have all threads observed the target epoch?
 	 */
-	LIST_FOREACH(t, &qs->list, entry) {
-		if (t->local_epoch < target) {
-			/* Not ready to G/C. */
-			return false;
-		}
+	if (!qsbr_scan(qs, target, &laggard)) {
+		/* Not ready to G/C. */
+		qsbr_stalled(qs, laggard);
+		self->sync_fail++;
+		return false;
 	}
 
 	/* Detected the grace period. */
+	self->sync_ok++;
+	return true;
+}
+
+/*
+ * qsbr_observed_p: return true if all registered threads have passed
+ * the checkpoint observing the target epoch.  Unlike qsbr_sync(), the
+ * caller does not pass the checkpoint and it need not be registered.
+ */
+bool
+qsbr_observed_p(qsbr_t *qs, qsbr_epoch_t target)
+{
+	qsbr_tls_t *laggard;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if (!qsbr_scan(qs, target, &laggard)) {
+		qsbr_stalled(qs, laggard);
+		atomic_fetch_add(&qs->sync_fail, 1);
+		return false;
+	}
+	atomic_fetch_add(&qs->sync_ok, 1);
 	return true;
 }
+
+/*
+ * qsbr_get_stats: get the statistics of the QSBR object.
+ */
+void
+qsbr_get_stats(qsbr_t *qs, qsbr_stats_t *stats)
+{
+	const unsigned nchunks = qs->nchunks;
+
+	stats->nthreads = 0;
+	stats->barriers = qs->global_epoch - 1;
+	stats->sync_ok = qs->sync_ok;
+	stats->sync_fail = qs->sync_fail;
+	for (unsigned i = 0; i < nchunks; i++) {
+		const unsigned nslots = QSBR_CHUNK_SLOTS << i;
+
+		for (unsigned j = 0; j < nslots; j++) {
+			const qsbr_tls_t *t = &qs->chunks[i][j];
+
+			if (t->used) {
+				stats->nthreads++;
+				stats->sync_ok += t->sync_ok;
+				stats->sync_fail += t->sync_fail;
+			}
+		}
+	}
+}
@@ -10,10 +10,35 @@
 
 #include <sys/cdefs.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 struct qsbr;
 typedef struct qsbr qsbr_t;
+
+struct qsbr_tls;
+typedef struct qsbr_tls qsbr_tls_t;
 typedef unsigned long qsbr_epoch_t;
+typedef void (*qsbr_cb_t)(void *);
+
+typedef struct {
+	unsigned	nthreads;
+	uint64_t	barriers;
+	uint64_t	sync_ok;
+	uint64_t	sync_fail;
+} qsbr_stats_t;
+
+/*
+ * The thread holding back the synchronisation: its label and for how
+ * long it has not passed a checkpoint since the barrier it lags behind.
+ */
+#define	QSBR_LABEL_LEN	16
+
+typedef struct {
+	char		label[QSBR_LABEL_LEN];
+	uint64_t	stall_nsec;
+} qsbr_laggard_t;
+
+typedef void (*qsbr_watchdog_t)(const qsbr_laggard_t *, void *);
 
 __BEGIN_DECLS
 
@@ -22,9 +47,31 @@ void		qsbr_destroy(qsbr_t *);
 
 void		qsbr_unregister(qsbr_t *);
 int		qsbr_register(qsbr_t *);
+bool		qsbr_registered_p(qsbr_t *);
 void		qsbr_checkpoint(qsbr_t *);
 qsbr_epoch_t	qsbr_barrier(qsbr_t *);
 bool		qsbr_sync(qsbr_t *, qsbr_epoch_t);
+bool		qsbr_observed_p(qsbr_t *, qsbr_epoch_t);
+void		qsbr_get_stats(qsbr_t *, qsbr_stats_t *);
+
+void		qsbr_set_label(qsbr_t *, const char *);
+unsigned	qsbr_laggards(qsbr_t *, qsbr_laggard_t *, unsigned);
+void		qsbr_set_watchdog(qsbr_t *, unsigned,
+		    qsbr_watchdog_t, void *);
+
+int		qsbr_notify_fd(qsbr_t *);
+bool		qsbr_notify_arm(qsbr_t *, qsbr_epoch_t);
+
+int		qsbr_defer(qsbr_t *, qsbr_cb_t, void *);
+bool		qsbr_poll(qsbr_t *);
+
+qsbr_tls_t *	qsbr_register_h(qsbr_t *);
+void		qsbr_checkpoint_h(qsbr_t *, qsbr_tls_t *);
+
+void		qsbr_thread_offline(qsbr_t *);
+void		qsbr_thread_online(qsbr_t *);
+void		qsbr_thread_offline_h(qsbr_t *, qsbr_tls_t *);
+void		qsbr_thread_online_h(qsbr_t *, qsbr_tls_t *);
 
 __END_DECLS
 
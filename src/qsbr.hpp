@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * C++ wrappers (header-only, C++11):
+ *
+ * - ebr_thread, qsbr_thread and gc_thread: the move-only registrations
+ *   of the current thread, unregistering on destruction.  Note: they
+ *   must be destroyed by the thread which created them.  The thread
+ *   must not be already registered (e.g. using the C API), since the
+ *   registration would be dropped by either owner.
+ *
+ * - ebr_guard and gc_guard: the RAII critical path guards; the ebr_guard
+ *   constructed from the ebr_thread uses the handle-based fast path.
+ *   qsbr_offline_guard: the thread is offline for the guard's lifetime.
+ *
+ * - gc<T, offsetof(T, entry), Deleter>: the typed G/C of the objects of
+ *   type T with the embedded gc_entry_t member at the given offset.  The
+ *   reclamation function is instantiated for the type, the offset and
+ *   the deleter, so the deleter calls are inlined rather than made via
+ *   a function pointer for each object.
+ *
+ * The errors are reported by throwing std::system_error.
+ */
+
+#ifndef	_QSBR_HPP_
+#define	_QSBR_HPP_
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "ebr.h"
+#include "qsbr.h"
+#include "gc.h"
+
+namespace libqsbr {
+
+namespace detail {
+
+[[noreturn]] inline void
+throw_errno(const char *what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace detail
+
+/*
+ * EBR.
+ */
+
+class ebr_thread {
+public:
+	explicit ebr_thread(ebr_t *ebr) : ebr_(ebr), tls_(nullptr)
+	{
+		if (ebr_registered_p(ebr)) {
+			/* The slot would be shared with another owner. */
+			errno = EEXIST;
+			detail::throw_errno("ebr_register_h");
+		}
+		if ((tls_ = ebr_register_h(ebr)) == nullptr) {
+			detail::throw_errno("ebr_register_h");
+		}
+	}
+
+	ebr_thread(ebr_thread &&other) noexcept :
+	    ebr_(other.ebr_), tls_(other.tls_)
+	{
+		other.ebr_ = nullptr;
+		other.tls_ = nullptr;
+	}
+
+	ebr_thread &
+	operator=(ebr_thread &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			ebr_ = other.ebr_;
+			tls_ = other.tls_;
+			other.ebr_ = nullptr;
+			other.tls_ = nullptr;
+		}
+		return *this;
+	}
+
+	ebr_thread(const ebr_thread &) = delete;
+	ebr_thread &operator=(const ebr_thread &) = delete;
+
+	~ebr_thread() { release(); }
+
+	void enter() noexcept { ebr_enter_h(ebr_, tls_); }
+	void exit() noexcept { ebr_exit_h(ebr_, tls_); }
+	ebr_t *domain() const noexcept { return ebr_; }
+	ebr_tls_t *handle() const noexcept { return tls_; }
+
+private:
+	void
+	release() noexcept
+	{
+		if (ebr_) {
+			ebr_unregister(ebr_);
+		}
+	}
+
+	ebr_t *		ebr_;
+	ebr_tls_t *	tls_;
+};
+
+class ebr_guard {
+public:
+	explicit ebr_guard(ebr_t *ebr) noexcept : ebr_(ebr), tls_(nullptr)
+	{
+		ebr_enter(ebr_);
+	}
+
+	explicit ebr_guard(ebr_thread &t) noexcept :
+	    ebr_(t.domain()), tls_(t.handle())
+	{
+		ebr_enter_h(ebr_, tls_);
+	}
+
+	ebr_guard(const ebr_guard &) = delete;
+	ebr_guard &operator=(const ebr_guard &) = delete;
+
+	~ebr_guard()
+	{
+		if (tls_) {
+			ebr_exit_h(ebr_, tls_);
+		} else {
+			ebr_exit(ebr_);
+		}
+	}
+
+private:
+	ebr_t *		ebr_;
+	ebr_tls_t *	tls_;
+};
+
+/*
+ * QSBR.
+ */
+
+class qsbr_thread {
+public:
+	explicit qsbr_thread(qsbr_t *qs) : qs_(qs), tls_(nullptr)
+	{
+		if (qsbr_registered_p(qs)) {
+			errno = EEXIST;
+			detail::throw_errno("qsbr_register_h");
+		}
+		if ((tls_ = qsbr_register_h(qs)) == nullptr) {
+			detail::throw_errno("qsbr_register_h");
+		}
+	}
+
+	qsbr_thread(qsbr_thread &&other) noexcept :
+	    qs_(other.qs_), tls_(other.tls_)
+	{
+		other.qs_ = nullptr;
+		other.tls_ = nullptr;
+	}
+
+	qsbr_thread &
+	operator=(qsbr_thread &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			qs_ = other.qs_;
+			tls_ = other.tls_;
+			other.qs_ = nullptr;
+			other.tls_ = nullptr;
+		}
+		return *this;
+	}
+
+	qsbr_thread(const qsbr_thread &) = delete;
+	qsbr_thread &operator=(const qsbr_thread &) = delete;
+
+	~qsbr_thread() { release(); }
+
+	void checkpoint() noexcept { qsbr_checkpoint_h(qs_, tls_); }
+	void offline() noexcept { qsbr_thread_offline_h(qs_, tls_); }
+	void online() noexcept { qsbr_thread_online_h(qs_, tls_); }
+	qsbr_t *domain() const noexcept { return qs_; }
+	qsbr_tls_t *handle() const noexcept { return tls_; }
+
+private:
+	void
+	release() noexcept
+	{
+		if (qs_) {
+			qsbr_unregister(qs_);
+		}
+	}
+
+	qsbr_t *	qs_;
+	qsbr_tls_t *	tls_;
+};
+
+class qsbr_offline_guard {
+public:
+	explicit qsbr_offline_guard(qsbr_thread &t) noexcept : t_(t)
+	{
+		t_.offline();
+	}
+
+	qsbr_offline_guard(const qsbr_offline_guard &) = delete;
+	qsbr_offline_guard &operator=(const qsbr_offline_guard &) = delete;
+
+	~qsbr_offline_guard() { t_.online(); }
+
+private:
+	qsbr_thread &	t_;
+};
+
+/*
+ * G/C.
+ */
+
+class gc_thread {
+public:
+	explicit gc_thread(gc_t *gc) : gc_(gc)
+	{
+		if (gc_registered_p(gc)) {
+			errno = EEXIST;
+			detail::throw_errno("gc_register");
+		}
+		if (gc_register(gc) == -1) {
+			detail::throw_errno("gc_register");
+		}
+	}
+
+	gc_thread(gc_thread &&other) noexcept : gc_(other.gc_)
+	{
+		other.gc_ = nullptr;
+	}
+
+	gc_thread &
+	operator=(gc_thread &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			gc_ = other.gc_;
+			other.gc_ = nullptr;
+		}
+		return *this;
+	}
+
+	gc_thread(const gc_thread &) = delete;
+	gc_thread &operator=(const gc_thread &) = delete;
+
+	~gc_thread() { release(); }
+
+	void checkpoint() noexcept { gc_checkpoint(gc_); }
+
+private:
+	void
+	release() noexcept
+	{
+		if (gc_) {
+			gc_unregister(gc_);
+		}
+	}
+
+	gc_t *		gc_;
+};
+
+class gc_guard {
+public:
+	explicit gc_guard(gc_t *gc) noexcept : gc_(gc) { gc_crit_enter(gc_); }
+
+	/* The typed G/C, see below. */
+	template <typename G>
+	explicit gc_guard(G &g) noexcept : gc_(g.get()) { gc_crit_enter(gc_); }
+
+	gc_guard(const gc_guard &) = delete;
+	gc_guard &operator=(const gc_guard &) = delete;
+
+	~gc_guard() { gc_crit_exit(gc_); }
+
+private:
+	gc_t *		gc_;
+};
+
+/*
+ * gc<T, offsetof(T, entry), Deleter>: the G/C of the objects of type T,
+ * destroyed using the deleter once reclaimed.  The offset is a constant,
+ * therefore the entry is converted to the object without any loads.  The
+ * flags are as for gc_create_ex(), except GC_POOL.  The object must not
+ * be moved, since the G/C refers to it; the pending objects are reclaimed
+ * on destruction.
+ */
+template <typename T, std::size_t Off,
+    typename Deleter = std::default_delete<T>>
+class gc {
+	static_assert(std::is_standard_layout<T>::value,
+	    "the object type must be standard-layout");
+	static_assert(Off + sizeof(gc_entry_t) <= sizeof(T),
+	    "the entry offset must be within the object");
+public:
+	explicit gc(unsigned flags = 0, Deleter deleter = Deleter()) :
+	    deleter_(std::move(deleter))
+	{
+		if (flags & GC_POOL) {
+			errno = EINVAL;
+			detail::throw_errno("gc_create_ex");
+		}
+		gc_ = gc_create_ex(Off, reclaim, this, flags);
+		if (gc_ == nullptr) {
+			detail::throw_errno("gc_create_ex");
+		}
+	}
+
+	gc(const gc &) = delete;
+	gc &operator=(const gc &) = delete;
+
+	~gc()
+	{
+		gc_full(gc_, 1);
+		gc_destroy(gc_);
+	}
+
+	gc_thread register_thread() { return gc_thread(gc_); }
+
+	void retire(T *obj) noexcept { gc_limbo(gc_, obj); }
+	void cycle() noexcept { gc_cycle(gc_); }
+	void full(unsigned msec = 1) noexcept { gc_full(gc_, msec); }
+	gc_t *get() const noexcept { return gc_; }
+
+private:
+	static void
+	reclaim(gc_entry_t *entry, void *arg)
+	{
+		gc *self = static_cast<gc *>(arg);
+
+		while (entry) {
+			T *obj = container_of(entry);
+
+			entry = entry->next;
+			self->deleter_(obj);
+		}
+	}
+
+	static T *
+	container_of(gc_entry_t *entry) noexcept
+	{
+		return reinterpret_cast<T *>(
+		    reinterpret_cast<char *>(entry) - Off);
+	}
+
+	gc_t *		gc_;
+	Deleter		deleter_;
+};
+
+} // namespace libqsbr
+
+#endif
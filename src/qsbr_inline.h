@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * The inline checkpoint fast path of QSBR: qsbr_checkpoint_inline() is
+ * equivalent to qsbr_checkpoint_h(), but avoids the function call.  It
+ * accesses the published leading members of the QSBR object and of the
+ * thread slot; see ebr_inline.h on the layout.  The notification and
+ * the deferred callbacks take the out-of-line slow path.
+ */
+
+#ifndef	_QSBR_INLINE_H_
+#define	_QSBR_INLINE_H_
+
+#include "qsbr.h"
+
+__BEGIN_DECLS
+
+/*
+ * The published layout: the global epoch and the armed notification
+ * target of the QSBR object; the local epoch and the deferred callback
+ * batches of the thread slot.
+ */
+typedef struct {
+	qsbr_epoch_t	global_epoch;
+	qsbr_epoch_t	notify_target;
+} qsbr_pub_t;
+
+typedef struct {
+	qsbr_epoch_t	local_epoch;
+	void *		defer_open;
+	void *		defer_list;
+} qsbr_tls_pub_t;
+
+#define	QSBR_PUB(qs, m)	\
+    ((const qsbr_pub_t *)(const void *)(qs))->m
+#define	QSBR_TLS_PUB(t, m) \
+    ((qsbr_tls_pub_t *)(void *)(t))->m
+
+void		qsbr_checkpoint_slow(qsbr_t *, qsbr_tls_t *);
+
+static inline void
+qsbr_checkpoint_inline(qsbr_t *qs, qsbr_tls_t *t)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	QSBR_TLS_PUB(t, local_epoch) = QSBR_PUB(qs, global_epoch);
+
+	if (__builtin_expect(QSBR_PUB(qs, notify_target) != 0 ||
+	    QSBR_TLS_PUB(t, defer_list) || QSBR_TLS_PUB(t, defer_open), 0)) {
+		qsbr_checkpoint_slow(qs, t);
+	}
+}
+
+__END_DECLS
+
+#endif
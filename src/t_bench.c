@@ -0,0 +1,818 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Scalability benchmark of the EBR, QSBR and G/C reclamation.
+ *
+ * The readers look up the objects in a small array of the published
+ * pointers and read them for the given critical section length; the
+ * writers replace the objects (a fraction of their operations, the rest
+ * being the reads) and retire the old ones, driving the reclamation.
+ * The results are printed in the CSV or JSON format, one record per run:
+ *
+ * - reader operations per second (the mean and the minimum per thread);
+ * - writer updates per second (total);
+ * - the synchronisation success rate (ebr_sync, qsbr_sync or the G/C);
+ * - the grace period latency percentiles, i.e. the time between the
+ *   retirement and the reclamation of an object (within 12.5%);
+ * - the peak number of the retired objects pending reclamation.
+ *
+ * The "ht" mode runs the same workload on the reference hash table (see
+ * ht.c) with the given number of keys, half of them present initially.
+ * The readers look up the random keys; the writers update the keys of
+ * their own partition, alternating the replacements and the removals
+ * (or the insertions, if the key is not present).  Use the update ratio
+ * to select a lookup-heavy (e.g. -u 10) or an update-heavy (-u 90) mix.
+ *
+ * Usage: t_bench [-m mode] [-r readers] [-w writers] [-u update-pct]
+ *                [-c cs-len] [-k keys] [-t msec] [-f csv|json]
+ *
+ * The modes: ebr, ebr-hier, ebr-mb, qsbr, gc, gc-qsbr, ht or all (default).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <err.h>
+
+#include "ebr.h"
+#include "qsbr.h"
+#include "gc.h"
+#include "ht.h"
+#include "utils.h"
+
+#define	BENCH_SLOTS		64
+#define	BENCH_MAGIC		0x5a5a5a5a5a5a5a5aULL
+
+/*
+ * Latency histogram: eight sub-buckets per power of two.
+ */
+#define	LAT_SUBBITS		3
+#define	LAT_SUB			(1U << LAT_SUBBITS)
+#define	LAT_BUCKETS		(64 * LAT_SUB)
+
+typedef enum {
+	MODE_EBR, MODE_EBR_HIER, MODE_EBR_MB, MODE_QSBR, MODE_GC, MODE_GC_QSBR,
+	MODE_HT, MODE_COUNT
+} bench_mode_t;
+
+static const char *		mode_names[MODE_COUNT] = {
+	"ebr", "ebr-hier", "ebr-mb", "qsbr", "gc", "gc-qsbr", "ht",
+};
+
+typedef struct bench_obj {
+	gc_entry_t		gc_entry;
+	uint64_t		val;
+	uint64_t		retire_time;
+	qsbr_epoch_t		epoch;
+} bench_obj_t;
+
+typedef struct {
+	pthread_t		thr;
+	unsigned		id;
+	bool			writer;
+	uint64_t		rng;
+
+	uint64_t		reads;
+	uint64_t		updates;
+	uint64_t		syncs;
+	uint64_t		sync_ok;
+
+	/*
+	 * The objects retired by the writer: the EBR limbo lists, one
+	 * per epoch, or the QSBR FIFO ordered by the target epoch.
+	 */
+	gc_entry_t *		limbo[EBR_EPOCHS];
+	gc_entry_t *		fifo_head;
+	gc_entry_t **		fifo_tail;
+} __aligned(CACHE_LINE_SIZE) bench_thread_t;
+
+typedef struct {
+	bench_mode_t		mode;
+	unsigned		nreaders;
+	unsigned		nwriters;
+	unsigned		update_pct;
+	unsigned		cs_len;
+	unsigned		nkeys;
+	unsigned		msec;
+} bench_conf_t;
+
+static bench_mode_t		mode;
+static unsigned			cs_len;
+static unsigned			update_pct;
+static unsigned			nreaders;
+static unsigned			nwriters;
+static unsigned			nkeys;
+
+static ebr_t *			ebr;
+static qsbr_t *			qsbr;
+static gc_t *			gc;
+static ht_t *			ht;
+
+static bench_obj_t *		slots[BENCH_SLOTS];
+static pthread_barrier_t	barrier;
+static volatile bool		stop;
+
+static uint64_t			pending;
+static uint64_t			peak_pending;
+static uint64_t			lat_hist[LAT_BUCKETS];
+static uint64_t			lat_max;
+
+static uint64_t
+bench_rand(bench_thread_t *bt)
+{
+	/* xorshift64 */
+	bt->rng ^= bt->rng << 13;
+	bt->rng ^= bt->rng >> 7;
+	bt->rng ^= bt->rng << 17;
+	return bt->rng;
+}
+
+static unsigned
+lat_bucket(uint64_t nsec)
+{
+	unsigned msb;
+
+	if (nsec < LAT_SUB) {
+		return (unsigned)nsec;
+	}
+	msb = 63 - (unsigned)__builtin_clzll(nsec);
+	return (msb - LAT_SUBBITS + 1) * LAT_SUB +
+	    (unsigned)((nsec >> (msb - LAT_SUBBITS)) & (LAT_SUB - 1));
+}
+
+static uint64_t
+lat_bucket_value(unsigned i)
+{
+	unsigned shift;
+
+	if (i < LAT_SUB) {
+		return i;
+	}
+	shift = i / LAT_SUB - 1;
+	return (uint64_t)(LAT_SUB + i % LAT_SUB) << shift;
+}
+
+static uint64_t
+lat_percentile(uint64_t total, double pct)
+{
+	const uint64_t rank = (uint64_t)(total * pct / 100);
+	uint64_t count = 0;
+
+	for (unsigned i = 0; i < LAT_BUCKETS; i++) {
+		count += lat_hist[i];
+		if (count > rank) {
+			return lat_bucket_value(i);
+		}
+	}
+	return 0;
+}
+
+static bench_obj_t *
+obj_create(void)
+{
+	bench_obj_t *obj;
+
+	if ((obj = malloc(sizeof(bench_obj_t))) == NULL) {
+		err(EXIT_FAILURE, "malloc");
+	}
+	obj->val = BENCH_MAGIC;
+	return obj;
+}
+
+static void
+obj_retire(bench_obj_t *obj)
+{
+	uint64_t n, peak;
+
+	obj->retire_time = clock_nsec();
+	n = atomic_fetch_add(&pending, 1) + 1;
+	while ((peak = peak_pending) < n &&
+	    !atomic_compare_exchange_weak(&peak_pending, peak, n)) {
+		continue;
+	}
+}
+
+static void
+obj_reclaim(bench_obj_t *obj, uint64_t now)
+{
+	const uint64_t nsec = now - obj->retire_time;
+	uint64_t max;
+
+	/* Do not account the final drain. */
+	if (!stop) {
+		atomic_fetch_add(&lat_hist[lat_bucket(nsec)], 1);
+		while ((max = lat_max) < nsec &&
+		    !atomic_compare_exchange_weak(&lat_max, max, nsec)) {
+			continue;
+		}
+	}
+	atomic_fetch_add(&pending, -1);
+	obj->val = 0;
+	free(obj);
+}
+
+static void
+obj_reclaim_list(gc_entry_t *entry)
+{
+	const uint64_t now = clock_nsec();
+
+	while (entry) {
+		bench_obj_t *obj = (void *)entry;
+
+		entry = entry->next;
+		obj_reclaim(obj, now);
+	}
+}
+
+static void
+gc_func(gc_entry_t *entry, void *arg)
+{
+	(void)arg;
+	obj_reclaim_list(entry);
+}
+
+static void
+ht_valfree(void *val, void *arg)
+{
+	(void)arg;
+	obj_reclaim(val, clock_nsec());
+}
+
+/*
+ * bench_read: look up a random object and read it for the critical
+ * section length.  The caller is responsible for the critical section.
+ */
+static void
+bench_read(bench_thread_t *bt)
+{
+	const unsigned i = bench_rand(bt) % BENCH_SLOTS;
+	bench_obj_t *obj;
+	uint64_t val = 0;
+
+	obj = atomic_load_explicit(&slots[i], memory_order_acquire);
+	for (unsigned n = 0; n <= cs_len; n++) {
+		val |= atomic_load_explicit(&obj->val, memory_order_relaxed);
+	}
+	if (val != BENCH_MAGIC) {
+		errx(EXIT_FAILURE, "use-after-free detected");
+	}
+	bt->reads++;
+}
+
+static void
+bench_ebr_update(bench_thread_t *bt, bench_obj_t *obj)
+{
+	unsigned epoch;
+	bool ok;
+
+	epoch = ebr_staging_epoch(ebr);
+	obj->gc_entry.next = bt->limbo[epoch];
+	bt->limbo[epoch] = &obj->gc_entry;
+
+	ok = ebr_sync(ebr, &epoch);
+	bt->sync_ok += ok;
+	bt->syncs++;
+
+	obj_reclaim_list(bt->limbo[epoch]);
+	bt->limbo[epoch] = NULL;
+}
+
+static void
+bench_qsbr_update(bench_thread_t *bt, bench_obj_t *obj)
+{
+	gc_entry_t *entry;
+
+	obj->epoch = qsbr_barrier(qsbr);
+	obj->gc_entry.next = NULL;
+	*bt->fifo_tail = &obj->gc_entry;
+	bt->fifo_tail = &obj->gc_entry.next;
+
+	/*
+	 * The targets are increasing: reclaim from the head while the
+	 * target epochs are observed.
+	 */
+	while ((entry = bt->fifo_head) != NULL) {
+		bench_obj_t *head = (void *)entry;
+		bool ok;
+
+		ok = qsbr_sync(qsbr, head->epoch);
+		bt->sync_ok += ok;
+		bt->syncs++;
+		if (!ok) {
+			break;
+		}
+		if ((bt->fifo_head = entry->next) == NULL) {
+			bt->fifo_tail = &bt->fifo_head;
+		}
+		obj_reclaim(head, clock_nsec());
+	}
+}
+
+/*
+ * bench_ht_read: look up a random key in the hash table.
+ */
+static void
+bench_ht_read(bench_thread_t *bt)
+{
+	const uint64_t key = bench_rand(bt) % nkeys;
+	bench_obj_t *obj;
+	uint64_t val = BENCH_MAGIC;
+
+	if ((obj = ht_get(ht, key)) != NULL) {
+		for (unsigned n = 0; n <= cs_len; n++) {
+			val &= atomic_load_explicit(&obj->val,
+			    memory_order_relaxed);
+		}
+	}
+	if (val != BENCH_MAGIC) {
+		errx(EXIT_FAILURE, "use-after-free detected");
+	}
+	bt->reads++;
+}
+
+/*
+ * bench_ht_update: update a random key of the writer's partition.  No
+ * other thread removes the value, so it can be stamped as retired before
+ * it is unlinked.
+ */
+static void
+bench_ht_update(bench_thread_t *bt)
+{
+	const unsigned wid = bt->id - nreaders;
+	const uint64_t r = bench_rand(bt);
+	const uint64_t key = (r % (nkeys / nwriters)) * nwriters + wid;
+	bench_obj_t *obj;
+
+	ht_enter(ht);
+	obj = ht_get(ht, key);
+	ht_exit(ht);
+
+	if (obj == NULL) {
+		if (ht_put(ht, key, obj_create()) == -1) {
+			err(EXIT_FAILURE, "ht_put");
+		}
+	} else if ((r >> 32) & 1) {
+		obj_retire(obj);
+		if (ht_put(ht, key, obj_create()) == -1) {
+			err(EXIT_FAILURE, "ht_put");
+		}
+	} else {
+		obj_retire(obj);
+		ht_del(ht, key);
+	}
+	bt->updates++;
+	gc_cycle(gc);
+}
+
+static void
+bench_update(bench_thread_t *bt)
+{
+	const unsigned i = bench_rand(bt) % BENCH_SLOTS;
+	bench_obj_t *obj;
+
+	if (mode == MODE_HT) {
+		bench_ht_update(bt);
+		return;
+	}
+	obj = atomic_exchange(&slots[i], obj_create());
+	obj_retire(obj);
+	bt->updates++;
+
+	switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		bench_ebr_update(bt, obj);
+		break;
+	case MODE_QSBR:
+		bench_qsbr_update(bt, obj);
+		break;
+	case MODE_GC:
+	case MODE_GC_QSBR:
+		gc_limbo(gc, obj);
+		gc_cycle(gc);
+		break;
+	default:
+		abort();
+	}
+}
+
+static void
+bench_op(bench_thread_t *bt, ebr_tls_t *et, qsbr_tls_t *qt)
+{
+	if (bt->writer && bench_rand(bt) % 100 < update_pct) {
+		bench_update(bt);
+	} else switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		ebr_enter_h(ebr, et);
+		bench_read(bt);
+		ebr_exit_h(ebr, et);
+		break;
+	case MODE_QSBR:
+	case MODE_GC_QSBR:
+		bench_read(bt);
+		break;
+	case MODE_GC:
+		gc_crit_enter(gc);
+		bench_read(bt);
+		gc_crit_exit(gc);
+		break;
+	case MODE_HT:
+		ht_enter(ht);
+		bench_ht_read(bt);
+		ht_exit(ht);
+		break;
+	default:
+		abort();
+	}
+
+	/* The quiescent state between the operations. */
+	if (mode == MODE_QSBR) {
+		qsbr_checkpoint_h(qsbr, qt);
+	} else if (mode == MODE_GC_QSBR) {
+		gc_checkpoint(gc);
+	}
+}
+
+static void *
+bench_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	ebr_tls_t *et = NULL;
+	qsbr_tls_t *qt = NULL;
+
+	switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		if ((et = ebr_register_h(ebr)) == NULL) {
+			err(EXIT_FAILURE, "ebr_register_h");
+		}
+		break;
+	case MODE_QSBR:
+		if ((qt = qsbr_register_h(qsbr)) == NULL) {
+			err(EXIT_FAILURE, "qsbr_register_h");
+		}
+		break;
+	default:
+		if (gc_register(gc) == -1) {
+			err(EXIT_FAILURE, "gc_register");
+		}
+		break;
+	}
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		bench_op(bt, et, qt);
+	}
+	pthread_barrier_wait(&barrier);
+
+	switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		ebr_unregister(ebr);
+		break;
+	case MODE_QSBR:
+		qsbr_unregister(qsbr);
+		break;
+	default:
+		gc_unregister(gc);
+		break;
+	}
+	return NULL;
+}
+
+static bool
+bench_setup(bench_mode_t m)
+{
+	static const unsigned ebr_flags[] = {
+		[MODE_EBR] = 0,
+		[MODE_EBR_HIER] = EBR_HIERARCHICAL,
+		[MODE_EBR_MB] = EBR_MEMBARRIER,
+	};
+
+	mode = m;
+	switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		if ((ebr = ebr_create_ex(ebr_flags[mode])) == NULL) {
+			warn("ebr_create_ex(%s)", mode_names[mode]);
+			return false;
+		}
+		break;
+	case MODE_QSBR:
+		if ((qsbr = qsbr_create()) == NULL) {
+			err(EXIT_FAILURE, "qsbr_create");
+		}
+		break;
+	case MODE_GC:
+	case MODE_GC_QSBR:
+		gc = gc_create_ex(offsetof(bench_obj_t, gc_entry), gc_func,
+		    NULL, mode == MODE_GC_QSBR ? GC_QSBR : 0);
+		if (gc == NULL) {
+			err(EXIT_FAILURE, "gc_create_ex");
+		}
+		break;
+	case MODE_HT:
+		if ((ht = ht_create(nkeys / 2, 0, ht_valfree, NULL)) == NULL) {
+			err(EXIT_FAILURE, "ht_create");
+		}
+		gc = ht_gc(ht);
+		for (unsigned i = 1; i < nkeys; i += 2) {
+			if (ht_put(ht, i, obj_create()) == -1) {
+				err(EXIT_FAILURE, "ht_put");
+			}
+		}
+		break;
+	default:
+		abort();
+	}
+	for (unsigned i = 0; i < BENCH_SLOTS; i++) {
+		slots[i] = obj_create();
+	}
+	memset(lat_hist, 0, sizeof(lat_hist));
+	lat_max = 0;
+	pending = peak_pending = 0;
+	return true;
+}
+
+static void
+bench_teardown(bench_thread_t *bts, unsigned nthreads,
+    uint64_t *syncs, uint64_t *sync_ok)
+{
+	/*
+	 * All threads have unregistered: the remaining objects are no
+	 * longer reachable by any reader.
+	 */
+	for (unsigned i = 0; i < nthreads; i++) {
+		bench_thread_t *bt = &bts[i];
+
+		for (unsigned e = 0; e < EBR_EPOCHS; e++) {
+			obj_reclaim_list(bt->limbo[e]);
+		}
+		obj_reclaim_list(bt->fifo_head);
+		*syncs += bt->syncs;
+		*sync_ok += bt->sync_ok;
+	}
+	for (unsigned i = 0; i < BENCH_SLOTS; i++) {
+		free(slots[i]);
+	}
+	switch (mode) {
+	case MODE_EBR:
+	case MODE_EBR_HIER:
+	case MODE_EBR_MB:
+		ebr_destroy(ebr);
+		break;
+	case MODE_QSBR:
+		qsbr_destroy(qsbr);
+		break;
+	default: {
+		gc_stats_t stats;
+
+		gc_full(gc, 1);
+		gc_get_stats(gc, &stats);
+		*syncs += stats.sync_ok + stats.sync_fail;
+		*sync_ok += stats.sync_ok;
+		if (mode == MODE_HT) {
+			ht_destroy(ht);
+		} else {
+			gc_destroy(gc);
+		}
+		break;
+	}
+	}
+}
+
+static void
+bench_report(const bench_conf_t *c, bench_thread_t *bts, uint64_t elapsed,
+    uint64_t syncs, uint64_t sync_ok, bool json, bool first)
+{
+	const unsigned nthreads = c->nreaders + c->nwriters;
+	const double sec = (double)elapsed / 1000000000;
+	uint64_t rops_min = UINT64_MAX, rops = 0, wops = 0, nlat = 0;
+	double rops_mean = 0;
+	char sync_pct[16];
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		const bench_thread_t *bt = &bts[i];
+
+		if (!bt->writer) {
+			rops += bt->reads;
+			rops_min = bt->reads < rops_min ?
+			    bt->reads : rops_min;
+		}
+		wops += bt->updates;
+	}
+	if (c->nreaders) {
+		rops_mean = (double)rops / c->nreaders / sec;
+	} else {
+		rops_min = 0;
+	}
+	/* Note: not every mode accounts the synchronisation attempts. */
+	if (syncs) {
+		snprintf(sync_pct, sizeof(sync_pct), "%.2f",
+		    100.0 * sync_ok / syncs);
+	} else {
+		strcpy(sync_pct, json ? "null" : "");
+	}
+	for (unsigned i = 0; i < LAT_BUCKETS; i++) {
+		nlat += lat_hist[i];
+	}
+
+	if (json) {
+		printf("%s\n  {\"mode\": \"%s\", \"readers\": %u, "
+		    "\"writers\": %u, \"update_pct\": %u, \"cs_len\": %u, "
+		    "\"keys\": %u, \"msec\": %u, \"reader_ops_s\": %.0f, "
+		    "\"reader_ops_s_min\": %.0f, \"writer_ops_s\": %.0f, "
+		    "\"sync_ok_pct\": %s, \"gp_p50_ns\": %"PRIu64", "
+		    "\"gp_p90_ns\": %"PRIu64", \"gp_p99_ns\": %"PRIu64", "
+		    "\"gp_max_ns\": %"PRIu64", \"peak_pending\": %"PRIu64"}",
+		    first ? "[" : ",", mode_names[c->mode], c->nreaders,
+		    c->nwriters, c->update_pct, c->cs_len, c->nkeys, c->msec,
+		    rops_mean,
+		    rops_min / sec, wops / sec, sync_pct,
+		    lat_percentile(nlat, 50), lat_percentile(nlat, 90),
+		    lat_percentile(nlat, 99), lat_max, peak_pending);
+		return;
+	}
+	printf("%s,%u,%u,%u,%u,%u,%u,%.0f,%.0f,%.0f,%s,"
+	    "%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n",
+	    mode_names[c->mode], c->nreaders, c->nwriters, c->update_pct,
+	    c->cs_len, c->nkeys, c->msec, rops_mean, rops_min / sec,
+	    wops / sec, sync_pct,
+	    lat_percentile(nlat, 50), lat_percentile(nlat, 90),
+	    lat_percentile(nlat, 99), lat_max, peak_pending);
+}
+
+static bool
+run_bench(const bench_conf_t *c, bool json, bool first)
+{
+	const unsigned nthreads = c->nreaders + c->nwriters;
+	const struct timespec dtime = {
+		c->msec / 1000, (c->msec % 1000) * 1000000
+	};
+	uint64_t start, elapsed, syncs = 0, sync_ok = 0;
+	bench_thread_t *bts;
+
+	cs_len = c->cs_len;
+	update_pct = c->update_pct;
+	nreaders = c->nreaders;
+	nwriters = c->nwriters;
+	nkeys = c->nkeys;
+	if (!bench_setup(c->mode)) {
+		return false;
+	}
+
+	if ((errno = posix_memalign((void **)&bts, CACHE_LINE_SIZE,
+	    nthreads * sizeof(bench_thread_t))) != 0) {
+		err(EXIT_FAILURE, "posix_memalign");
+	}
+	memset(bts, 0, nthreads * sizeof(bench_thread_t));
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	stop = false;
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		bench_thread_t *bt = &bts[i];
+
+		bt->id = i;
+		bt->writer = i >= c->nreaders;
+		bt->rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+		bt->fifo_tail = &bt->fifo_head;
+		if ((errno = pthread_create(&bt->thr, NULL,
+		    bench_thread, bt)) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	start = clock_nsec();
+	(void)nanosleep(&dtime, NULL);
+	stop = true;
+	elapsed = clock_nsec() - start;
+	pthread_barrier_wait(&barrier);
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		pthread_join(bts[i].thr, NULL);
+	}
+	pthread_barrier_destroy(&barrier);
+
+	bench_teardown(bts, nthreads, &syncs, &sync_ok);
+	bench_report(c, bts, elapsed, syncs, sync_ok, json, first);
+	fflush(stdout);
+	free(bts);
+	return true;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+	    "Usage: %s [-m mode] [-r readers] [-w writers] [-u update-pct]\n"
+	    "          [-c cs-len] [-k keys] [-t msec] [-f csv|json]\n"
+	    "\n"
+	    "Modes: ebr, ebr-hier, ebr-mb, qsbr, gc, gc-qsbr, ht or all\n",
+	    prog);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	bench_conf_t conf = {
+		.nreaders = ncpu > 1 ? (unsigned)ncpu - 1 : 1,
+		.nwriters = 1,
+		.update_pct = 100,
+		.cs_len = 0,
+		.nkeys = 65536,
+		.msec = 1000,
+	};
+	bool json = false, first = true;
+	int mode_sel = -1, ch;
+
+	while ((ch = getopt(argc, argv, "m:r:w:u:c:k:t:f:")) != -1) {
+		switch (ch) {
+		case 'm':
+			if (strcmp(optarg, "all") == 0) {
+				mode_sel = -1;
+				break;
+			}
+			for (mode_sel = 0; mode_sel < MODE_COUNT; mode_sel++) {
+				if (!strcmp(optarg, mode_names[mode_sel])) {
+					break;
+				}
+			}
+			if (mode_sel == MODE_COUNT) {
+				usage(argv[0]);
+			}
+			break;
+		case 'r':
+			conf.nreaders = (unsigned)atoi(optarg);
+			break;
+		case 'w':
+			conf.nwriters = (unsigned)atoi(optarg);
+			break;
+		case 'u':
+			conf.update_pct = (unsigned)atoi(optarg);
+			if (conf.update_pct > 100) {
+				usage(argv[0]);
+			}
+			break;
+		case 'c':
+			conf.cs_len = (unsigned)atoi(optarg);
+			break;
+		case 'k':
+			conf.nkeys = (unsigned)atoi(optarg);
+			break;
+		case 't':
+			conf.msec = (unsigned)atoi(optarg);
+			break;
+		case 'f':
+			if (strcmp(optarg, "json") == 0) {
+				json = true;
+			} else if (strcmp(optarg, "csv") != 0) {
+				usage(argv[0]);
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (conf.nreaders + conf.nwriters == 0 ||
+	    conf.nkeys < 2 || conf.nkeys < conf.nwriters) {
+		usage(argv[0]);
+	}
+
+	if (!json) {
+		puts("mode,readers,writers,update_pct,cs_len,keys,msec,"
+		    "reader_ops_s,reader_ops_s_min,writer_ops_s,sync_ok_pct,"
+		    "gp_p50_ns,gp_p90_ns,gp_p99_ns,gp_max_ns,peak_pending");
+	}
+	for (unsigned m = 0; m < MODE_COUNT; m++) {
+		if (mode_sel != -1 && m != (unsigned)mode_sel) {
+			continue;
+		}
+		conf.mode = m;
+		if (run_bench(&conf, json, first)) {
+			first = false;
+		}
+	}
+	if (json) {
+		puts(first ? "[]" : "\n]");
+	}
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Unit tests of the C++ wrappers.
+ */
+
+#include <cstdio>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include "qsbr.hpp"
+
+namespace {
+
+unsigned	ndestroyed;
+
+struct obj {
+	unsigned	val;
+	gc_entry_t	entry;
+
+	explicit obj(unsigned v) : val(v), entry() {}
+	~obj() { ndestroyed++; }
+};
+
+struct counting_deleter {
+	unsigned *	count;
+
+	void
+	operator()(obj *o) const
+	{
+		(*count)++;
+		delete o;
+	}
+};
+
+/*
+ * throws_eexist: return true if the function throws std::system_error
+ * with EEXIST, i.e. the registration of an already registered thread.
+ */
+template <typename F>
+bool
+throws_eexist(F f)
+{
+	try {
+		f();
+	} catch (const std::system_error &e) {
+		return e.code().value() == EEXIST;
+	}
+	return false;
+}
+
+void
+test_ebr()
+{
+	ebr_t *ebr = ebr_create();
+	assert(ebr != nullptr);
+	{
+		libqsbr::ebr_thread t(ebr);
+		{
+			libqsbr::ebr_guard g(t);
+			assert(ebr_incrit_p(ebr));
+		}
+		assert(!ebr_incrit_p(ebr));
+
+		/* Move-only: the moved-from object does not unregister. */
+		libqsbr::ebr_thread t2(std::move(t));
+		{
+			libqsbr::ebr_guard g(ebr);
+			assert(ebr_incrit_p(ebr));
+		}
+		ebr_full_sync(ebr, 1);
+
+		/* The registration is not shared. */
+		assert(ebr_registered_p(ebr));
+		assert(throws_eexist([ebr] { libqsbr::ebr_thread t3(ebr); }));
+		assert(ebr_registered_p(ebr));
+	}
+	assert(!ebr_registered_p(ebr));
+
+	/* Neither with the C API. */
+	ebr_register(ebr);
+	assert(throws_eexist([ebr] { libqsbr::ebr_thread t(ebr); }));
+	assert(ebr_registered_p(ebr));
+	ebr_unregister(ebr);
+
+	ebr_stats_t stats;
+	ebr_get_stats(ebr, &stats);
+	assert(stats.nthreads == 0);
+	ebr_destroy(ebr);
+}
+
+void
+test_qsbr()
+{
+	qsbr_t *qs = qsbr_create();
+	assert(qs != nullptr);
+	{
+		libqsbr::qsbr_thread t(qs);
+		qsbr_epoch_t target = qsbr_barrier(qs);
+
+		t.checkpoint();
+		assert(qsbr_observed_p(qs, target));
+
+		/* The offline thread is not waited for. */
+		libqsbr::qsbr_offline_guard off(t);
+		target = qsbr_barrier(qs);
+		assert(qsbr_observed_p(qs, target));
+		(void)target;
+
+		assert(throws_eexist([qs] { libqsbr::qsbr_thread t2(qs); }));
+		assert(qsbr_registered_p(qs));
+	}
+	assert(!qsbr_registered_p(qs));
+	qsbr_destroy(qs);
+}
+
+void
+test_gc()
+{
+	ndestroyed = 0;
+	{
+		libqsbr::gc<obj, offsetof(obj, entry)> gc;
+		libqsbr::gc_thread t = gc.register_thread();
+		obj *o = new obj(1);
+
+		{
+			libqsbr::gc_guard g(gc);
+			assert(o->val == 1);
+		}
+		gc.retire(o);
+		gc.full();
+		assert(ndestroyed == 1);
+
+		assert(throws_eexist([&gc] { gc.register_thread(); }));
+		assert(gc_registered_p(gc.get()));
+
+		/* Pending objects are reclaimed on destruction. */
+		gc.retire(new obj(2));
+		gc.retire(new obj(3));
+	}
+	assert(ndestroyed == 3);
+
+	/* The QSBR mode and a custom deleter. */
+	unsigned count = 0;
+	{
+		libqsbr::gc<obj, offsetof(obj, entry), counting_deleter>
+		    gc(GC_QSBR, counting_deleter{&count});
+
+		std::thread thr([&gc] {
+			libqsbr::gc_thread t(gc.get());
+			for (unsigned i = 0; i < 100; i++) {
+				gc.retire(new obj(i));
+				gc.cycle();
+				t.checkpoint();
+			}
+		});
+		thr.join();
+		gc.full();
+		assert(count == 100);
+	}
+	assert(ndestroyed == 103);
+
+	/* The pooled G/C is not supported. */
+	bool thrown = false;
+	try {
+		libqsbr::gc<obj, offsetof(obj, entry)> gc(GC_POOL);
+	} catch (const std::system_error &) {
+		thrown = true;
+	}
+	assert(thrown);
+	(void)thrown;
+}
+
+} // namespace
+
+int
+main()
+{
+	test_ebr();
+	test_qsbr();
+	test_gc();
+	std::puts("ok");
+	return 0;
+}
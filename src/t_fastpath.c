@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Microbenchmark of the reader fast paths: the cost of a single
+ * ebr_enter() and ebr_exit() pair or qsbr_checkpoint() call via the
+ * TLS lookup, the handle and the inline functions.  Single-threaded,
+ * i.e. the uncontended cost.  See the "fastbench" target, which builds
+ * it against the objects and against the static LTO library.
+ *
+ * Usage: t_fastpath [label [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <err.h>
+
+#include "ebr.h"
+#include "ebr_inline.h"
+#include "qsbr.h"
+#include "qsbr_inline.h"
+#include "utils.h"
+
+/*
+ * TIME_LOOP: run the statement n times and set nsec to the average
+ * time of an iteration.
+ */
+#define	TIME_LOOP(nsec, n, stmt)				\
+do {								\
+	const uint64_t _start = clock_nsec();			\
+	for (uint64_t _i = 0; _i < (n); _i++) {			\
+		stmt;						\
+	}							\
+	(nsec) = (double)(clock_nsec() - _start) / (n);		\
+} while (0)
+
+static void
+report(const char *label, const char *name, double nsec)
+{
+	printf("%-10s %-28s %8.2f\n", label, name, nsec);
+}
+
+static void
+bench_ebr(const char *label, const char *mode, unsigned flags, uint64_t n)
+{
+	char name[64];
+	double nsec;
+	ebr_tls_t *t;
+	ebr_t *ebr;
+
+	if ((ebr = ebr_create_ex(flags)) == NULL) {
+		/* E.g. membarrier(2) is not supported. */
+		return;
+	}
+	if ((t = ebr_register_h(ebr)) == NULL) {
+		err(EXIT_FAILURE, "ebr_register_h");
+	}
+
+	TIME_LOOP(nsec, n, ebr_enter(ebr); ebr_exit(ebr));
+	snprintf(name, sizeof(name), "%s enter/exit", mode);
+	report(label, name, nsec);
+
+	TIME_LOOP(nsec, n, ebr_enter_h(ebr, t); ebr_exit_h(ebr, t));
+	snprintf(name, sizeof(name), "%s enter_h/exit_h", mode);
+	report(label, name, nsec);
+
+	TIME_LOOP(nsec, n, ebr_enter_inline(ebr, t); ebr_exit_inline(ebr, t));
+	snprintf(name, sizeof(name), "%s enter/exit_inline", mode);
+	report(label, name, nsec);
+
+	ebr_unregister(ebr);
+	ebr_destroy(ebr);
+}
+
+static void
+bench_qsbr(const char *label, uint64_t n)
+{
+	qsbr_tls_t *t;
+	double nsec;
+	qsbr_t *qs;
+
+	if ((qs = qsbr_create()) == NULL) {
+		err(EXIT_FAILURE, "qsbr_create");
+	}
+	if ((t = qsbr_register_h(qs)) == NULL) {
+		err(EXIT_FAILURE, "qsbr_register_h");
+	}
+
+	TIME_LOOP(nsec, n, qsbr_checkpoint(qs));
+	report(label, "qsbr checkpoint", nsec);
+
+	TIME_LOOP(nsec, n, qsbr_checkpoint_h(qs, t));
+	report(label, "qsbr checkpoint_h", nsec);
+
+	TIME_LOOP(nsec, n, qsbr_checkpoint_inline(qs, t));
+	report(label, "qsbr checkpoint_inline", nsec);
+
+	qsbr_unregister(qs);
+	qsbr_destroy(qs);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *label = argc > 1 ? argv[1] : "-";
+	uint64_t n = 10 * 1000 * 1000;
+
+	if (argc > 2 && (n = strtoull(argv[2], NULL, 10)) == 0) {
+		errx(EXIT_FAILURE, "invalid number of iterations");
+	}
+
+	printf("%-10s %-28s %8s\n", "build", "operation", "ns/op");
+	bench_ebr(label, "ebr", 0, n);
+	bench_ebr(label, "ebr-mb", EBR_MEMBARRIER, n);
+	bench_qsbr(label, n);
+	return 0;
+}
@@ -5,15 +5,30 @@
  * Use is subject to license terms, as specified in the LICENSE file.
  */
 
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <assert.h>
 
 #include "gc.h"
+#include "ebr.h"
+#include "ebr_inline.h"
+#include "ebr_shm.h"
+#include "qsbr.h"
+#include "qsbr_inline.h"
+#include "hp.h"
+#include "ibr.h"
+#include "ht.h"
 
 typedef struct {
 	bool		destroyed;
@@ -97,13 +112,1472 @@ test_basic(void)
 	gc_full(gc, 1);
 	assert(obj.destroyed);
 
+	gc_unregister(gc);
 	gc_destroy(gc);
 }
 
+static void
+test_unregister(void)
+{
+	gc_t *gc;
+	obj_t obj[2];
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * Objects staged by the unregistered thread.
+	 */
+	gc_limbo(gc, &obj[0]);
+	gc_full(gc, 1);
+	assert(obj[0].destroyed);
+
+	/*
+	 * Objects left in the per-thread lists on unregister.
+	 */
+	gc_register(gc);
+	gc_limbo(gc, &obj[1]);
+	gc_unregister(gc);
+	assert(!obj[1].destroyed);
+
+	gc_full(gc, 1);
+	assert(obj[1].destroyed);
+
+	gc_destroy(gc);
+}
+
+static void
+test_chain(void)
+{
+	gc_t *gc;
+	obj_t obj[5];
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * Chain staged by the unregistered thread.
+	 */
+	obj[0].entry.next = &obj[1].entry;
+	obj[1].entry.next = &obj[2].entry;
+	gc_limbo_chain(gc, &obj[0], &obj[2], 3);
+
+	/*
+	 * Chains staged by the registered thread.
+	 */
+	gc_register(gc);
+	obj[3].entry.next = &obj[4].entry;
+	gc_limbo_chain(gc, &obj[3], &obj[4], 2);
+	gc_full(gc, 1);
+	gc_unregister(gc);
+
+	for (unsigned i = 0; i < 5; i++) {
+		assert(obj[i].destroyed);
+	}
+	gc_destroy(gc);
+}
+
+static void
+test_worker(void)
+{
+	gc_t *gc;
+	obj_t obj;
+	int ret;
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	ret = gc_start_worker(gc, 1);
+	assert(ret == 0); (void)ret;
+
+	/*
+	 * The worker should reclaim the object on its own.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj);
+	for (unsigned i = 0; i < 10000; i++) {
+		if (*(volatile bool *)&obj.destroyed) {
+			break;
+		}
+		usleep(1000);
+	}
+	assert(obj.destroyed);
+
+	/*
+	 * The idle worker sleeps without a timeout: staging the objects,
+	 * also by a registered thread, must wake it up.
+	 */
+	usleep(10000);
+	gc_register(gc);
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj);
+	for (unsigned i = 0; i < 10000; i++) {
+		if (*(volatile bool *)&obj.destroyed) {
+			break;
+		}
+		usleep(1000);
+	}
+	assert(obj.destroyed);
+	gc_unregister(gc);
+
+	gc_stop_worker(gc);
+	gc_destroy(gc);
+}
+
+static void
+test_helpers(void)
+{
+	gc_stats_t stats;
+	uint64_t nobjs = 0;
+	gc_t *gc;
+	obj_t obj[100];
+	int ret;
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	ret = gc_start_helpers(gc, 2, 8);
+	assert(ret == 0); (void)ret;
+
+	ret = gc_start_helpers(gc, 2, 8);
+	assert(ret == -1 && errno == EEXIST);
+
+	/*
+	 * The list is split into the chunks and reclaimed by the helpers;
+	 * gc_full() must wait for all of them.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	gc_register(gc);
+	for (unsigned i = 0; i < 100; i++) {
+		gc_limbo(gc, &obj[i]);
+	}
+	gc_full(gc, 1);
+	for (unsigned i = 0; i < 100; i++) {
+		assert(obj[i].destroyed);
+	}
+	gc_get_stats(gc, &stats);
+	assert(stats.reclaimed == 100 && stats.pending == 0);
+	for (unsigned i = 0; i < GC_LATENCY_BUCKETS; i++) {
+		nobjs += stats.latency[i];
+	}
+	assert(nobjs == 100);
+
+	/*
+	 * Stopping the helpers falls back to the inline reclamation.
+	 */
+	gc_stop_helpers(gc);
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj[0]);
+	gc_full(gc, 1);
+	assert(obj[0].destroyed);
+	gc_unregister(gc);
+
+	gc_destroy(gc);
+}
+
+typedef struct {
+	gc_t *		gc;
+	obj_t *		next;
+	unsigned	count;
+} reenter_arg_t;
+
+/*
+ * reenter_objs: the reclamation function calling back into the G/C.
+ */
+static void
+reenter_objs(gc_entry_t *entry, void *arg)
+{
+	reenter_arg_t *ra = arg;
+	obj_t *next = ra->next;
+	gc_stats_t stats;
+
+	/* Note: the G/C may call back, e.g. to expedite a cycle. */
+	free_objs(entry, NULL);
+	gc_get_stats(ra->gc, &stats);
+	ra->next = NULL;
+	if (next) {
+		gc_limbo(ra->gc, next);
+	}
+	ra->count++;
+}
+
+static void
+test_reenter(void)
+{
+	reenter_arg_t ra;
+	obj_t obj[2];
+	gc_t *gc;
+
+	/*
+	 * The reclamation function may take the G/C lock (here, via
+	 * gc_get_stats()) and stage more objects.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	memset(&ra, 0, sizeof(ra));
+	gc = gc_create(offsetof(obj_t, entry), reenter_objs, &ra);
+	assert(gc != NULL);
+	ra.gc = gc;
+	ra.next = &obj[1];
+
+	gc_register(gc);
+	gc_limbo(gc, &obj[0]);
+	gc_full(gc, 1);
+	assert(obj[0].destroyed && obj[1].destroyed);
+	assert(ra.count == 2);
+	gc_unregister(gc);
+	gc_destroy(gc);
+}
+
+static void
+test_reenter_limit(void)
+{
+	/*
+	 * The reclamation function staging more objects over the hard
+	 * limit must not block: the objects being reclaimed are still
+	 * pending.  Both inline, by the blocked caller, and on the worker.
+	 */
+	for (unsigned i = 0; i < 2; i++) {
+		reenter_arg_t ra;
+		obj_t obj[2];
+		gc_t *gc;
+
+		memset(&obj, 0, sizeof(obj));
+		memset(&ra, 0, sizeof(ra));
+		gc = gc_create(offsetof(obj_t, entry), reenter_objs, &ra);
+		assert(gc != NULL);
+		ra.gc = gc;
+		ra.next = &obj[1];
+		gc_set_limits(gc, 1, 1, GC_LIMIT_BLOCK);
+		if (i && gc_start_worker(gc, 1) == -1) {
+			abort();
+		}
+
+		/* Not registered: accounted immediately. */
+		gc_limbo(gc, &obj[0]);
+		gc_full(gc, 1);
+		assert(obj[0].destroyed && obj[1].destroyed);
+		assert(ra.count == 2);
+		gc_destroy(gc);
+	}
+}
+
+typedef struct {
+	unsigned	val;
+	gc_entry_t	entry;
+} pool_obj_t;
+
+static void
+test_pool(void)
+{
+	pool_obj_t *obj, *ptr;
+	void *large;
+	gc_t *gc;
+
+	gc = gc_create_ex(offsetof(pool_obj_t, entry), NULL, NULL, GC_POOL);
+	assert(gc != NULL);
+	gc_register(gc);
+
+	/*
+	 * The reclaimed object is recycled by the next allocation.
+	 */
+	obj = gc_alloc(gc, sizeof(pool_obj_t));
+	assert(obj != NULL);
+	obj->val = 1;
+	gc_limbo(gc, obj);
+	gc_full(gc, 1);
+	ptr = gc_alloc(gc, sizeof(pool_obj_t));
+	assert(ptr == obj);
+
+	/* Also, the one released directly. */
+	gc_free(gc, ptr);
+	ptr = gc_alloc(gc, sizeof(pool_obj_t));
+	assert(ptr == obj);
+	gc_free(gc, ptr);
+
+	/* The large objects are not pooled. */
+	large = gc_alloc(gc, 64 * 1024);
+	assert(large != NULL);
+	gc_limbo(gc, large);
+	gc_full(gc, 1);
+	gc_unregister(gc);
+
+	/*
+	 * The cached objects were handed over to the depot.
+	 */
+	ptr = gc_alloc(gc, sizeof(pool_obj_t));
+	assert(ptr == obj);
+	gc_free(gc, ptr);
+	gc_destroy(gc);
+}
+
+static void
+test_limits(void)
+{
+	gc_t *gc;
+	obj_t obj[2];
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * Soft limit of one object: the G/C cycle is expedited.
+	 */
+	gc_set_limits(gc, 1, 0, 0);
+	gc_limbo(gc, &obj[0]);
+	assert(obj[0].destroyed);
+
+	/*
+	 * Limits in bytes, with blocking at the hard limit.
+	 */
+	gc_register(gc);
+	gc_set_limits(gc, 64 * 1024, 128 * 1024,
+	    GC_LIMIT_BYTES | GC_LIMIT_BLOCK);
+	gc_limbo_sized(gc, &obj[1], 128 * 1024);
+	assert(obj[1].destroyed);
+	gc_unregister(gc);
+
+	gc_destroy(gc);
+}
+
+static void
+test_stats(void)
+{
+	gc_stats_t stats;
+	uint64_t nobjs = 0;
+	gc_t *gc;
+	obj_t obj[2];
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	memset(&obj, 0, sizeof(obj));
+
+	gc_register(gc);
+	gc_get_stats(gc, &stats);
+	assert(stats.nthreads == 1);
+	assert(stats.retired == 0 && stats.pending == 0);
+
+	gc_limbo(gc, &obj[0]);
+	gc_crit_enter(gc);
+	gc_limbo(gc, &obj[1]);
+	gc_cycle(gc);
+	gc_get_stats(gc, &stats);
+	assert(stats.retired == 2 && stats.staged == 2);
+	assert(stats.pending == 2);
+	gc_crit_exit(gc);
+
+	gc_full(gc, 1);
+	gc_get_stats(gc, &stats);
+	assert(stats.reclaimed == 2 && stats.pending == 0);
+	assert(stats.sync_ok > 0 && stats.sync_fail > 0);
+	for (unsigned i = 0; i < GC_LATENCY_BUCKETS; i++) {
+		nobjs += stats.latency[i];
+	}
+	assert(nobjs == 2);
+
+	gc_unregister(gc);
+	gc_get_stats(gc, &stats);
+	assert(stats.nthreads == 0 && stats.retired == 2);
+
+	/*
+	 * The latency is from the retirement (here, into the global
+	 * limbo list) rather than from the staging.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj[0]);
+	usleep(5000);
+	gc_full(gc, 1);
+	gc_get_stats(gc, &stats);
+	assert(stats.reclaimed == 3);
+	nobjs = 0;
+	for (unsigned i = 13; i < GC_LATENCY_BUCKETS; i++) {
+		nobjs += stats.latency[i];
+	}
+	assert(nobjs == 1);
+	gc_destroy(gc);
+}
+
+static void
+test_qsbr_backend(void)
+{
+	gc_t *gc;
+	obj_t obj;
+	unsigned n = 0;
+
+	gc = gc_create_ex(offsetof(obj_t, entry), free_objs, NULL, GC_QSBR);
+	assert(gc != NULL);
+	gc_register(gc);
+
+	/* The critical path is a no-op. */
+	gc_crit_enter(gc);
+	gc_crit_exit(gc);
+
+	/*
+	 * Not reclaimed until the thread passes the checkpoints.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj);
+	for (unsigned i = 0; i < EBR_EPOCHS * 2; i++) {
+		gc_cycle(gc);
+	}
+	assert(!obj.destroyed);
+
+	while (!obj.destroyed) {
+		gc_checkpoint(gc);
+		gc_cycle(gc);
+		assert(++n <= EBR_EPOCHS * 2);
+	}
+
+	/*
+	 * Full call.
+	 */
+	memset(&obj, 0, sizeof(obj));
+	gc_limbo(gc, &obj);
+	gc_full(gc, 1);
+	assert(obj.destroyed);
+
+	gc_unregister(gc);
+	gc_destroy(gc);
+}
+
+static void
+test_hp(void)
+{
+	hp_stats_t stats;
+	obj_t obj[2], *ptr;
+	void *shared;
+	hp_t *hp;
+
+	hp = hp_create(2, offsetof(obj_t, entry), free_objs, NULL);
+	assert(hp != NULL);
+	hp_register(hp);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * Protected object is not reclaimed until the slot is cleared.
+	 */
+	shared = &obj[0];
+	ptr = hp_protect(hp, 0, &shared);
+	assert(ptr == &obj[0]);
+
+	shared = &obj[1];
+	hp_retire(hp, ptr);
+	hp_scan(hp);
+	assert(!obj[0].destroyed);
+
+	hp_clear(hp, 0);
+	hp_scan(hp);
+	assert(obj[0].destroyed);
+
+	/*
+	 * Full call; the record is reused on re-registration.
+	 */
+	shared = NULL;
+	hp_retire(hp, &obj[1]);
+	hp_full(hp, 1);
+	assert(obj[1].destroyed);
+
+	hp_unregister(hp);
+	hp_register(hp);
+	hp_get_stats(hp, &stats);
+	assert(stats.nthreads == 1);
+	assert(stats.retired == 2 && stats.reclaimed == 2);
+
+	hp_unregister(hp);
+	hp_destroy(hp);
+}
+
+typedef struct {
+	bool		destroyed;
+	ibr_entry_t	entry;
+} ibr_obj_t;
+
+static void
+free_ibr_objs(gc_entry_t *entry, void *arg)
+{
+	while (entry) {
+		ibr_obj_t *obj;
+
+		obj = (void *)((uintptr_t)entry - offsetof(ibr_obj_t, entry));
+		entry = entry->next;
+		obj->destroyed = true;
+	}
+	(void)arg;
+}
+
+static void
+test_ibr(void)
+{
+	ibr_obj_t obj[2], *ptr;
+	ibr_stats_t stats;
+	void *shared;
+	ibr_t *ibr;
+
+	ibr = ibr_create(offsetof(ibr_obj_t, entry), free_ibr_objs, NULL);
+	assert(ibr != NULL);
+	ibr_register(ibr);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * The object which was read in the critical path is reserved.
+	 */
+	ibr_birth(ibr, &obj[0]);
+	shared = &obj[0];
+	ibr_enter(ibr);
+	ptr = ibr_read(ibr, &shared);
+	assert(ptr == &obj[0]);
+
+	shared = NULL;
+	ibr_limbo(ibr, ptr);
+	ibr_cycle(ibr);
+	assert(!obj[0].destroyed);
+
+	/*
+	 * However, the object born after the interval is not.
+	 */
+	ibr_birth(ibr, &obj[1]);
+	ibr_limbo(ibr, &obj[1]);
+	ibr_cycle(ibr);
+	assert(obj[1].destroyed);
+	assert(!obj[0].destroyed);
+
+	ibr_exit(ibr);
+	ibr_full(ibr, 1);
+	assert(obj[0].destroyed);
+
+	ibr_get_stats(ibr, &stats);
+	assert(stats.nthreads == 1);
+	assert(stats.retired == 2 && stats.reclaimed == 2);
+
+	ibr_unregister(ibr);
+	ibr_destroy(ibr);
+}
+
+typedef struct {
+	ibr_t *			ibr;
+	pthread_barrier_t	barrier;
+	unsigned		nadvance;
+} ibr_reader_arg_t;
+
+static void *
+ibr_reader_thread(void *arg)
+{
+	ibr_reader_arg_t *ra = arg;
+
+	/*
+	 * Advance the epoch the given number of times, stepping with
+	 * the main thread, then reserve the interval until told to exit.
+	 */
+	ibr_register(ra->ibr);
+	for (unsigned i = 0; i < ra->nadvance; i++) {
+		ibr_cycle(ra->ibr);
+		pthread_barrier_wait(&ra->barrier);
+		pthread_barrier_wait(&ra->barrier);
+	}
+	ibr_enter(ra->ibr);
+	pthread_barrier_wait(&ra->barrier);
+	pthread_barrier_wait(&ra->barrier);
+	ibr_exit(ra->ibr);
+	ibr_unregister(ra->ibr);
+	return NULL;
+}
+
+/*
+ * Multiple readers: the objects whose lifetimes fall between the
+ * reserved intervals are reclaimed, the ones overlapping are not.
+ */
+static void
+test_ibr_intervals(void)
+{
+	ibr_reader_arg_t ra[2];
+	ibr_obj_t obj[3];
+	pthread_t thr[2];
+	ibr_t *ibr;
+	int ret;
+
+	ibr = ibr_create(offsetof(ibr_obj_t, entry), free_ibr_objs, NULL);
+	assert(ibr != NULL);
+	ibr_register(ibr);
+	memset(&obj, 0, sizeof(obj));
+
+	for (unsigned i = 0; i < 2; i++) {
+		ra[i].ibr = ibr;
+		ra[i].nadvance = i * 2;
+		pthread_barrier_init(&ra[i].barrier, NULL, 2);
+	}
+
+	/* The first reader reserves [e0, e0]. */
+	ibr_birth(ibr, &obj[0]);
+	ret = pthread_create(&thr[0], NULL, ibr_reader_thread, &ra[0]);
+	assert(ret == 0);
+	pthread_barrier_wait(&ra[0].barrier);
+
+	/* Epoch e1: the objects living [e0, e1] and [e1, e1]. */
+	ret = pthread_create(&thr[1], NULL, ibr_reader_thread, &ra[1]);
+	assert(ret == 0);
+	pthread_barrier_wait(&ra[1].barrier);
+	ibr_birth(ibr, &obj[1]);
+	ibr_birth(ibr, &obj[2]);
+	ibr_limbo(ibr, &obj[0]);
+	ibr_limbo(ibr, &obj[1]);
+	pthread_barrier_wait(&ra[1].barrier);
+
+	/* Epoch e2: the second reader reserves [e2, e2]. */
+	pthread_barrier_wait(&ra[1].barrier);
+	pthread_barrier_wait(&ra[1].barrier);
+	pthread_barrier_wait(&ra[1].barrier);
+	ibr_limbo(ibr, &obj[2]);
+
+	ibr_cycle(ibr);
+	assert(!obj[0].destroyed);
+	assert(obj[1].destroyed);
+	assert(!obj[2].destroyed);
+
+	for (unsigned i = 0; i < 2; i++) {
+		pthread_barrier_wait(&ra[i].barrier);
+		pthread_join(thr[i], NULL);
+		pthread_barrier_destroy(&ra[i].barrier);
+	}
+	ibr_full(ibr, 1);
+	assert(obj[0].destroyed && obj[2].destroyed);
+
+	ibr_unregister(ibr);
+	ibr_destroy(ibr);
+	(void)ret;
+}
+
+static pthread_barrier_t	qsbr_barrier_obj;
+
+static void *
+qsbr_offline_thread(void *arg)
+{
+	qsbr_t *qs = arg;
+
+	qsbr_register(qs);
+	qsbr_thread_offline(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_thread_online(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_checkpoint(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	qsbr_unregister(qs);
+	return NULL;
+}
+
+static void
+test_qsbr_offline(void)
+{
+	qsbr_epoch_t target;
+	pthread_t thr;
+	qsbr_t *qs;
+	int ret;
+
+	qs = qsbr_create();
+	assert(qs != NULL);
+	qsbr_register(qs);
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, qsbr_offline_thread, qs);
+	assert(ret == 0);
+
+	/* The other thread is offline: it must be ignored. */
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	target = qsbr_barrier(qs);
+	assert(qsbr_sync(qs, target));
+
+	/* Online, but did not pass a checkpoint. */
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	target = qsbr_barrier(qs);
+	assert(!qsbr_sync(qs, target));
+
+	/* Passed the checkpoint. */
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	assert(qsbr_sync(qs, target));
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+
+	/* The offline thread itself may synchronise too. */
+	qsbr_thread_offline(qs);
+	target = qsbr_barrier(qs);
+	assert(qsbr_sync(qs, target));
+	qsbr_thread_online(qs);
+
+	qsbr_unregister(qs);
+	qsbr_destroy(qs);
+	(void)ret;
+}
+
+static unsigned		qsbr_cb_count;
+
+static void
+count_cb(void *arg)
+{
+	(void)arg;
+	qsbr_cb_count++;
+}
+
+static void *
+qsbr_defer_exit_thread(void *arg)
+{
+	qsbr_t *qs = arg;
+
+	/* Exit without unregistering: the TLS destructor hands over. */
+	qsbr_register(qs);
+	qsbr_defer(qs, count_cb, NULL);
+	return NULL;
+}
+
+static void *
+qsbr_defer_thread(void *arg)
+{
+	qsbr_t *qs = arg;
+
+	qsbr_register(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	/* Leave the pending callback to the other thread. */
+	qsbr_defer(qs, count_cb, NULL);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_unregister(qs);
+	return NULL;
+}
+
+static void *
+ebr_reader_thread(void *arg)
+{
+	ebr_t *ebr = arg;
+
+	ebr_register(ebr);
+	ebr_enter(ebr);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	usleep(50 * 1000);
+	ebr_exit(ebr);
+	ebr_unregister(ebr);
+	return NULL;
+}
+
+typedef struct {
+	ebr_t *		ebr;
+	bool		inline_exit;
+	struct timespec	exit_time;
+} wakeup_arg_t;
+
+static void *
+ebr_wakeup_thread(void *arg)
+{
+	wakeup_arg_t *wa = arg;
+	ebr_tls_t *t;
+
+	t = ebr_register_h(wa->ebr);
+	assert(t != NULL);
+	ebr_enter_h(wa->ebr, t);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	usleep(50 * 1000);
+	if (wa->inline_exit) {
+		ebr_exit_inline(wa->ebr, t);
+	} else {
+		ebr_exit_h(wa->ebr, t);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &wa->exit_time);
+	ebr_unregister(wa->ebr);
+	return NULL;
+}
+
+static void *
+gc_reader_thread(void *arg)
+{
+	gc_t *gc = arg;
+
+	gc_register(gc);
+	gc_crit_enter(gc);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	gc_crit_exit(gc);
+	gc_unregister(gc);
+	return NULL;
+}
+
+static void
+test_throttle(void)
+{
+	struct timespec t0, t1;
+	uint64_t elapsed;
+	pthread_t thr;
+	obj_t obj;
+	gc_t *gc;
+	int ret;
+
+	gc = gc_create(offsetof(obj_t, entry), free_objs, NULL);
+	assert(gc != NULL);
+	memset(&obj, 0, sizeof(obj));
+
+	/*
+	 * The reader in the critical path holds off the reclamation:
+	 * the writer over the hard limit must be delayed, but not
+	 * blocked.
+	 */
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, gc_reader_thread, gc);
+	assert(ret == 0); (void)ret;
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	gc_register(gc);
+	gc_set_limits(gc, 0, 1, GC_LIMIT_BYTES);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	gc_limbo_sized(gc, &obj, 128 * 1024);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	elapsed = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000 +
+	    (uint64_t)(t1.tv_nsec / 1000) - (uint64_t)(t0.tv_nsec / 1000);
+	assert(elapsed >= 2000 && elapsed < 1000000); (void)elapsed;
+	assert(!obj.destroyed);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+
+	gc_full(gc, 1);
+	assert(obj.destroyed);
+	gc_unregister(gc);
+	gc_destroy(gc);
+}
+
+static void
+test_ebr_wait(void)
+{
+	struct timespec t0, t1;
+	unsigned gc_epoch;
+	uint64_t elapsed;
+	pthread_t thr;
+	ebr_t *ebr;
+	int ret;
+
+	ebr = ebr_create();
+	assert(ebr != NULL);
+
+	/* No readers -- nothing to wait for. */
+	assert(!ebr_wait(ebr, 1000));
+
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, ebr_reader_thread, ebr);
+	assert(ret == 0); (void)ret;
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	(void)ebr_sync(ebr, &gc_epoch);
+
+	/*
+	 * The reader leaving the critical path must wake us up well
+	 * before the timeout.
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	ebr_full_sync(ebr, 5000);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	elapsed = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000 +
+	    (uint64_t)(t1.tv_nsec / 1000000) - (uint64_t)(t0.tv_nsec / 1000000);
+	assert(elapsed < 2500); (void)elapsed;
+
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+	ebr_destroy(ebr);
+}
+
+/*
+ * Measure the wakeup latency: the time from the reader leaving the
+ * critical path to the return of the waiting synchroniser.  It must be
+ * far below the timeout in all modes, including no timeout.
+ */
+static void
+test_ebr_wakeup(void)
+{
+	static const unsigned modes[] = { 0, EBR_MEMBARRIER, EBR_HIERARCHICAL };
+	static const unsigned timeouts[] = { 5000, 0 };
+
+	for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		ebr_t *ebr;
+
+		if ((ebr = ebr_create_ex(modes[m])) == NULL) {
+			/* E.g. membarrier(2) is not supported. */
+			continue;
+		}
+		for (unsigned i = 0; i < 2 * sizeof(timeouts) /
+		    sizeof(timeouts[0]); i++) {
+			wakeup_arg_t wa = { .ebr = ebr, .inline_exit = i & 1 };
+			struct timespec t1;
+			unsigned gc_epoch;
+			uint64_t latency;
+			pthread_t thr;
+			int ret;
+
+			pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+			ret = pthread_create(&thr, NULL,
+			    ebr_wakeup_thread, &wa);
+			assert(ret == 0); (void)ret;
+			pthread_barrier_wait(&qsbr_barrier_obj);
+			(void)ebr_sync(ebr, &gc_epoch);
+
+			ebr_full_sync(ebr, timeouts[i / 2]);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			pthread_join(thr, NULL);
+			pthread_barrier_destroy(&qsbr_barrier_obj);
+
+			latency = (uint64_t)(t1.tv_sec - wa.exit_time.tv_sec) *
+			    1000000 + (uint64_t)(t1.tv_nsec / 1000) -
+			    (uint64_t)(wa.exit_time.tv_nsec / 1000);
+			assert((int64_t)latency < 100 * 1000); (void)latency;
+		}
+		ebr_destroy(ebr);
+	}
+}
+
+static void
+test_ebr_shm(void)
+{
+	const size_t len = ebr_shm_size(4);
+	int p2c[2], c2p[2], ret, status;
+	ebr_shm_stats_t stats;
+	unsigned gc_epoch;
+	ebr_shm_t *shm;
+	void *mem;
+	pid_t pid;
+	char c = 0;
+
+	mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(mem != MAP_FAILED);
+	shm = ebr_shm_init(mem, len, 4);
+	assert(shm != NULL);
+	assert(ebr_shm_attach(mem, len - 1) == NULL);
+
+	ret = pipe(p2c);
+	assert(ret == 0);
+	ret = pipe(c2p);
+	assert(ret == 0);
+
+	/*
+	 * The child process enters the critical path and waits; the
+	 * epoch may advance at most once.
+	 */
+	if ((pid = fork()) == 0) {
+		ebr_shm_t *cshm = ebr_shm_attach(mem, len);
+		int slot;
+
+		if (cshm == NULL || (slot = ebr_shm_register(cshm)) == -1) {
+			_exit(EXIT_FAILURE);
+		}
+		ebr_shm_enter(cshm, slot);
+		if (write(c2p[1], &c, 1) != 1 || read(p2c[0], &c, 1) != 1) {
+			_exit(EXIT_FAILURE);
+		}
+		ebr_shm_exit(cshm, slot);
+		ebr_shm_unregister(cshm, slot);
+
+		/* Enter again and exit without unregistering. */
+		slot = ebr_shm_register(cshm);
+		ebr_shm_enter(cshm, slot);
+		_exit(EXIT_SUCCESS);
+	}
+	assert(pid != -1);
+	ret = read(c2p[0], &c, 1);
+	assert(ret == 1);
+
+	(void)ebr_shm_sync(shm, &gc_epoch);
+	assert(!ebr_shm_sync(shm, &gc_epoch));
+	ebr_shm_get_stats(shm, &stats);
+	assert(stats.nslots == 4 && stats.nused == 1);
+
+	/*
+	 * Let the child exit.  Its slot remains active until reaped.
+	 */
+	ret = write(p2c[1], &c, 1);
+	assert(ret == 1);
+	ret = waitpid(pid, &status, 0);
+	assert(ret == pid && WIFEXITED(status));
+	assert(WEXITSTATUS(status) == EXIT_SUCCESS);
+
+	(void)ebr_shm_sync(shm, &gc_epoch);
+	assert(!ebr_shm_sync(shm, &gc_epoch));
+	ret = ebr_shm_reap(shm);
+	assert(ret == 1); (void)ret;
+	assert(ebr_shm_sync(shm, &gc_epoch));
+	ebr_shm_full_sync(shm, 1);
+
+	ebr_shm_get_stats(shm, &stats);
+	assert(stats.nused == 0 && stats.sync_ok > 0);
+
+	close(p2c[0]); close(p2c[1]);
+	close(c2p[0]); close(c2p[1]);
+	munmap(mem, len);
+}
+
+static unsigned		watchdog_count;
+
+static void
+ebr_watchdog(const ebr_laggard_t *lag, void *arg)
+{
+	assert(strcmp(lag->label, "stalled") == 0);
+	assert(arg == &watchdog_count);
+	watchdog_count++;
+}
+
+static void *
+ebr_stalled_thread(void *arg)
+{
+	ebr_t *ebr = arg;
+
+	ebr_register(ebr);
+	ebr_set_label(ebr, "stalled");
+	ebr_enter(ebr);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	ebr_exit(ebr);
+	ebr_unregister(ebr);
+	return NULL;
+}
+
+static void
+test_ebr_laggards(void)
+{
+	ebr_laggard_t lags[2];
+	unsigned gc_epoch, n;
+	pthread_t thr;
+	ebr_t *ebr;
+	int ret;
+
+	ebr = ebr_create();
+	assert(ebr != NULL);
+	ebr_set_watchdog(ebr, 1, ebr_watchdog, &watchdog_count);
+	watchdog_count = 0;
+
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, ebr_stalled_thread, ebr);
+	assert(ret == 0); (void)ret;
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	/*
+	 * The thread holds back the epoch: the watchdog must fire once
+	 * the threshold is exceeded and only once per stall.
+	 */
+	(void)ebr_sync(ebr, &gc_epoch);
+	assert(!ebr_sync(ebr, &gc_epoch));
+	usleep(2000);
+	assert(!ebr_sync(ebr, &gc_epoch));
+	assert(!ebr_sync(ebr, &gc_epoch));
+	assert(watchdog_count == 1);
+
+	n = ebr_laggards(ebr, lags, 2);
+	assert(n == 1); (void)n;
+	assert(strcmp(lags[0].label, "stalled") == 0);
+	assert(lags[0].stall_nsec >= 2000000);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	assert(ebr_laggards(ebr, lags, 2) == 0);
+
+	/*
+	 * Another thread reusing the slot stalls: its stall is new and
+	 * not reported yet, i.e. the watchdog must fire again.
+	 */
+	ret = pthread_create(&thr, NULL, ebr_stalled_thread, ebr);
+	assert(ret == 0);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	assert(ebr_sync(ebr, &gc_epoch));
+	assert(!ebr_sync(ebr, &gc_epoch));
+	usleep(2000);
+	assert(!ebr_sync(ebr, &gc_epoch));
+	assert(watchdog_count == 2);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+
+	assert(ebr_laggards(ebr, lags, 2) == 0);
+	assert(ebr_sync(ebr, &gc_epoch));
+	ebr_destroy(ebr);
+}
+
+static void
+qsbr_watchdog(const qsbr_laggard_t *lag, void *arg)
+{
+	assert(strcmp(lag->label, "stalled") == 0);
+	(void)arg;
+	watchdog_count++;
+}
+
+static void *
+qsbr_stalled_thread(void *arg)
+{
+	qsbr_t *qs = arg;
+
+	qsbr_register(qs);
+	qsbr_set_label(qs, "stalled");
+	qsbr_checkpoint(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_unregister(qs);
+	return NULL;
+}
+
+static void
+test_qsbr_laggards(void)
+{
+	qsbr_laggard_t lags[2];
+	qsbr_epoch_t target;
+	pthread_t thr;
+	qsbr_t *qs;
+	unsigned n;
+	int ret;
+
+	qs = qsbr_create();
+	assert(qs != NULL);
+	qsbr_set_watchdog(qs, 1, qsbr_watchdog, NULL);
+	watchdog_count = 0;
+
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, qsbr_stalled_thread, qs);
+	assert(ret == 0); (void)ret;
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	/*
+	 * The thread does not pass a checkpoint after the barrier.
+	 */
+	target = qsbr_barrier(qs);
+	assert(!qsbr_observed_p(qs, target));
+	usleep(2000);
+	assert(!qsbr_observed_p(qs, target));
+	assert(!qsbr_observed_p(qs, target));
+	assert(watchdog_count == 1);
+
+	n = qsbr_laggards(qs, lags, 2);
+	assert(n == 1); (void)n;
+	assert(strcmp(lags[0].label, "stalled") == 0);
+	assert(lags[0].stall_nsec >= 2000000);
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+
+	assert(qsbr_laggards(qs, lags, 2) == 0);
+	assert(qsbr_observed_p(qs, target));
+	qsbr_destroy(qs);
+}
+
+static void *
+qsbr_notify_thread(void *arg)
+{
+	qsbr_t *qs = arg;
+
+	qsbr_register(qs);
+	qsbr_checkpoint(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_checkpoint(qs);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	qsbr_unregister(qs);
+	return NULL;
+}
+
+static bool
+notify_readable(int fd, int msec)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint64_t val;
+
+	if (poll(&pfd, 1, msec) != 1) {
+		return false;
+	}
+	assert(pfd.revents & POLLIN);
+	if (read(fd, &val, sizeof(val)) != sizeof(val)) {
+		return false;
+	}
+	return val != 0;
+}
+
+static void
+test_qsbr_notify(void)
+{
+	qsbr_epoch_t target;
+	pthread_t thr;
+	qsbr_t *qs;
+	int fd, ret;
+
+	qs = qsbr_create();
+	assert(qs != NULL);
+	qsbr_register(qs);
+	fd = qsbr_notify_fd(qs);
+	assert(fd != -1);
+	assert(qsbr_notify_fd(qs) == fd);
+
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, qsbr_notify_thread, qs);
+	assert(ret == 0); (void)ret;
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	/*
+	 * The other thread has not observed the target: no notification
+	 * until it passes a checkpoint.
+	 */
+	target = qsbr_barrier(qs);
+	assert(!qsbr_notify_arm(qs, target));
+	qsbr_checkpoint(qs);
+	assert(!notify_readable(fd, 0));
+
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	assert(notify_readable(fd, 1000));
+	assert(!notify_readable(fd, 0));
+
+	/* Already observed: signalled immediately. */
+	assert(qsbr_notify_arm(qs, target));
+	assert(notify_readable(fd, 0));
+
+	/* The last lagging thread unregisters. */
+	target = qsbr_barrier(qs);
+	assert(!qsbr_notify_arm(qs, target));
+	qsbr_checkpoint(qs);
+	assert(!notify_readable(fd, 0));
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+	assert(notify_readable(fd, 1000));
+
+	qsbr_unregister(qs);
+	qsbr_destroy(qs);
+}
+
+static void
+test_qsbr_defer(void)
+{
+	pthread_t thr;
+	qsbr_t *qs;
+	int ret;
+
+	qs = qsbr_create();
+	assert(qs != NULL);
+	qsbr_register(qs);
+
+	/* Single thread: more than a batch. */
+	for (unsigned i = 0; i < 100; i++) {
+		ret = qsbr_defer(qs, count_cb, NULL);
+		assert(ret == 0);
+	}
+	while (!qsbr_poll(qs)) {
+		continue;
+	}
+	assert(qsbr_cb_count == 100);
+
+	/* Another thread which does not pass the checkpoint. */
+	pthread_barrier_init(&qsbr_barrier_obj, NULL, 2);
+	ret = pthread_create(&thr, NULL, qsbr_defer_thread, qs);
+	assert(ret == 0);
+	pthread_barrier_wait(&qsbr_barrier_obj);
+
+	qsbr_defer(qs, count_cb, NULL);
+	assert(!qsbr_poll(qs));
+	assert(!qsbr_poll(qs));
+	assert(qsbr_cb_count == 100);
+
+	/* Once it unregisters, its callbacks are adopted. */
+	pthread_barrier_wait(&qsbr_barrier_obj);
+	pthread_join(thr, NULL);
+	pthread_barrier_destroy(&qsbr_barrier_obj);
+	while (!qsbr_poll(qs)) {
+		continue;
+	}
+	assert(qsbr_cb_count == 102);
+
+	/*
+	 * Nor are the callbacks of an exiting thread lost (or inherited
+	 * by the next thread claiming the slot).
+	 */
+	ret = pthread_create(&thr, NULL, qsbr_defer_exit_thread, qs);
+	assert(ret == 0);
+	pthread_join(thr, NULL);
+	while (!qsbr_poll(qs)) {
+		continue;
+	}
+	assert(qsbr_cb_count == 103);
+
+	/* The remaining callbacks are run on destroy. */
+	qsbr_defer(qs, count_cb, NULL);
+	qsbr_unregister(qs);
+	qsbr_destroy(qs);
+	assert(qsbr_cb_count == 104);
+	(void)ret;
+}
+
+static void
+test_inline(void)
+{
+	const unsigned modes[] = { 0, EBR_HIERARCHICAL };
+	unsigned gc_epoch, count;
+	qsbr_epoch_t target;
+	ebr_tls_t *et;
+	qsbr_tls_t *qt;
+	qsbr_t *qs;
+
+	/* EBR: interoperates with the out-of-line paths. */
+	for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		ebr_t *ebr = ebr_create_ex(modes[i]);
+
+		assert(ebr != NULL);
+		et = ebr_register_h(ebr);
+		assert(et != NULL);
+
+		ebr_enter_inline(ebr, et);
+		assert(ebr_incrit_p_h(ebr, et));
+		ebr_exit_inline(ebr, et);
+		assert(!ebr_incrit_p_h(ebr, et));
+
+		ebr_enter_h(ebr, et);
+		ebr_exit_inline(ebr, et);
+		assert(!ebr_incrit_p(ebr));
+		assert(ebr_sync(ebr, &gc_epoch));
+
+		ebr_unregister(ebr);
+		ebr_destroy(ebr);
+	}
+
+	/* QSBR: the checkpoint, also running the deferred callbacks. */
+	qs = qsbr_create();
+	assert(qs != NULL);
+	qt = qsbr_register_h(qs);
+	assert(qt != NULL);
+
+	target = qsbr_barrier(qs);
+	assert(!qsbr_observed_p(qs, target));
+	qsbr_checkpoint_inline(qs, qt);
+	assert(qsbr_observed_p(qs, target));
+
+	count = qsbr_cb_count;
+	qsbr_defer(qs, count_cb, NULL);
+	for (unsigned i = 0; i < 16 && qsbr_cb_count == count; i++) {
+		qsbr_checkpoint_inline(qs, qt);
+	}
+	assert(qsbr_cb_count == count + 1);
+
+	qsbr_unregister(qs);
+	qsbr_destroy(qs);
+}
+
+static unsigned		ht_freed;
+
+static void
+ht_valfree(void *val, void *arg)
+{
+	assert(val != NULL);
+	(void)arg;
+	ht_freed++;
+}
+
+static void
+test_ht(void)
+{
+	const unsigned nkeys = 10000;
+	ht_t *ht;
+
+	ht = ht_create(0, GC_POOL, NULL, NULL);
+	assert(ht == NULL && errno == EINVAL);
+
+	ht = ht_create(0, 0, ht_valfree, NULL);
+	assert(ht != NULL);
+	ht_register(ht);
+	ht_freed = 0;
+
+	/*
+	 * Insert, replace and remove: the old values are destroyed
+	 * once reclaimed.
+	 */
+	ht_enter(ht);
+	assert(ht_get(ht, 1) == NULL);
+	ht_exit(ht);
+
+	assert(ht_put(ht, 1, (void *)1) == 0);
+	assert(ht_put(ht, 1, (void *)2) == 0);
+	ht_enter(ht);
+	assert(ht_get(ht, 1) == (void *)2);
+	ht_exit(ht);
+	assert(ht_count(ht) == 1);
+	gc_full(ht_gc(ht), 1);
+	assert(ht_freed == 1);
+
+	assert(ht_del(ht, 1));
+	assert(!ht_del(ht, 1));
+	assert(ht_count(ht) == 0);
+	gc_full(ht_gc(ht), 1);
+	assert(ht_freed == 2);
+
+	/*
+	 * Grow the table: the values survive the copying.
+	 */
+	for (unsigned i = 0; i < nkeys; i++) {
+		assert(ht_put(ht, i, (void *)(uintptr_t)(i + 1)) == 0);
+	}
+	assert(ht_count(ht) == nkeys);
+	gc_full(ht_gc(ht), 1);
+	assert(ht_freed == 2);
+
+	for (unsigned i = 0; i < nkeys; i += 2) {
+		assert(ht_del(ht, i));
+	}
+	gc_full(ht_gc(ht), 1);
+	assert(ht_freed == 2 + nkeys / 2);
+
+	ht_enter(ht);
+	for (unsigned i = 0; i < nkeys; i++) {
+		void *val = ht_get(ht, i);
+		assert(val == ((i & 1) ? (void *)(uintptr_t)(i + 1) : NULL));
+		(void)val;
+	}
+	ht_exit(ht);
+
+	/* The remaining values are destroyed with the table. */
+	ht_unregister(ht);
+	ht_destroy(ht);
+	assert(ht_freed == 2 + nkeys);
+
+	/* The QSBR mode. */
+	ht = ht_create(64, GC_QSBR, NULL, NULL);
+	assert(ht != NULL);
+	ht_register(ht);
+	assert(ht_put(ht, 1, (void *)1) == 0);
+	assert(ht_get(ht, 1) == (void *)1);
+	assert(ht_del(ht, 1));
+	gc_full(ht_gc(ht), 1);
+	ht_unregister(ht);
+	ht_destroy(ht);
+}
+
 int
 main(void)
 {
 	test_basic();
+	test_unregister();
+	test_chain();
+	test_worker();
+	test_helpers();
+	test_reenter();
+	test_reenter_limit();
+	test_pool();
+	test_limits();
+	test_throttle();
+	test_stats();
+	test_qsbr_backend();
+	test_hp();
+	test_ibr();
+	test_ibr_intervals();
+	test_qsbr_offline();
+	test_qsbr_defer();
+	test_ebr_shm();
+	test_ebr_laggards();
+	test_ebr_wait();
+	test_ebr_wakeup();
+	test_qsbr_laggards();
+	test_qsbr_notify();
+	test_inline();
+	test_ht();
 	puts("ok");
 	return 0;
 }
@@ -5,6 +5,8 @@
  * Use is subject to license terms, as specified in the LICENSE file.
  */
 
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -18,8 +20,12 @@
 #include <err.h>
 
 #include "ebr.h"
+#include "ebr_shm.h"
 #include "qsbr.h"
 #include "gc.h"
+#include "hp.h"
+#include "ibr.h"
+#include "ht.h"
 #include "utils.h"
 
 static unsigned			nsec = 10; /* seconds */
@@ -35,7 +41,8 @@ typedef struct {
 	unsigned int		visible;
 	unsigned int		gc_epoch;
 	gc_entry_t		gc_entry;
-	char			_pad[CACHE_LINE_SIZE - 8 - 4 - 4 - 8];
+	ibr_entry_t		ibr_entry;
+	char			_pad[CACHE_LINE_SIZE - 8 - 4 - 4 - 8 - 24];
 } data_struct_t;
 
 #define	DS_COUNT		4
@@ -45,13 +52,25 @@ typedef struct {
 static unsigned			magic_val = MAGIC_VAL;
 
 static ebr_t *			ebr;
+static unsigned			ebr_flags;
+static ebr_shm_t *		ebr_shm;
 static qsbr_t *			qsbr;
 static gc_t *			gc;
+static hp_t *			hp;
+static ibr_t *			ibr;
+static ht_t *			ht;
+static unsigned			gc_flags;
+static unsigned			gc_helpers;
 
 static data_struct_t		ds[DS_COUNT]
     __attribute__((__aligned__(CACHE_LINE_SIZE)));
 static uint64_t			destructions;
 
+/*
+ * Note: the hazard pointer and IBR tests use the pointers as visibility.
+ */
+static data_struct_t *		ds_ptrs[DS_COUNT];
+
 static void
 access_obj(data_struct_t *obj)
 {
@@ -83,7 +102,7 @@ static void
 mock_destroy_obj(data_struct_t *obj)
 {
 	obj->ptr = NULL;
-	destructions++;
+	atomic_fetch_add(&destructions, 1);
 }
 
 /*
@@ -169,6 +188,161 @@ ebr_stress(void *arg)
 	return NULL;
 }
 
+static void *
+ebr_h_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	ebr_tls_t *t;
+
+	/*
+	 * As ebr_stress(), but using the handle-based routines.
+	 */
+
+	t = ebr_register_h(ebr);
+	assert(t != NULL);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			ebr_writer(n);
+			continue;
+		}
+		ebr_enter_h(ebr, t);
+		access_obj(&ds[n]);
+		ebr_exit_h(ebr, t);
+	}
+	pthread_barrier_wait(&barrier);
+	ebr_unregister(ebr);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * Process-shared EBR stress test (using the threads as the workers).
+ */
+
+static void
+ebr_shm_writer(unsigned target)
+{
+	data_struct_t *obj = &ds[target];
+	unsigned gc_epoch;
+
+	/*
+	 * See the ebr_writer() function for more details.
+	 */
+	if (obj->visible) {
+		mock_remove_obj(obj);
+		obj->gc_epoch = EPOCH_OFF + ebr_shm_staging_epoch(ebr_shm);
+	} else if (!obj->gc_epoch) {
+		mock_insert_obj(obj);
+	}
+	ebr_shm_sync(ebr_shm, &gc_epoch);
+	if (obj->gc_epoch == EPOCH_OFF + gc_epoch) {
+		mock_destroy_obj(obj);
+		obj->gc_epoch = 0;
+	}
+}
+
+static void *
+ebr_shm_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	int slot;
+
+	slot = ebr_shm_register(ebr_shm);
+	assert(slot != -1);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			ebr_shm_writer(n);
+			continue;
+		}
+		ebr_shm_enter(ebr_shm, slot);
+		access_obj(&ds[n]);
+		ebr_shm_exit(ebr_shm, slot);
+	}
+	pthread_barrier_wait(&barrier);
+	ebr_shm_unregister(ebr_shm, slot);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * ebr_shm_reaper: leave a slot in the critical path behind a process
+ * which exits without unregistering and race the other reapers.
+ */
+static void
+ebr_shm_reaper(void)
+{
+	pid_t pid;
+
+	if ((pid = fork()) == -1) {
+		err(EXIT_FAILURE, "fork");
+	}
+	if (pid == 0) {
+		const int slot = ebr_shm_register(ebr_shm);
+
+		if (slot != -1) {
+			ebr_shm_enter(ebr_shm, slot);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+	while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+		continue;
+	}
+	for (unsigned i = 0; i < 16; i++) {
+		ebr_shm_reap(ebr_shm);
+	}
+}
+
+static void *
+ebr_shm_reap_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	int slot = -1;
+
+	if (id == 0) {
+		slot = ebr_shm_register(ebr_shm);
+		assert(slot != -1);
+	}
+
+	/*
+	 * The writer (ID 0), the reapers (odd IDs) and the readers, which
+	 * keep claiming the slots, possibly just released by the reapers.
+	 */
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			ebr_shm_writer(n);
+			continue;
+		}
+		if (id & 1) {
+			ebr_shm_reaper();
+			continue;
+		}
+		if ((slot = ebr_shm_register(ebr_shm)) == -1) {
+			continue;
+		}
+		for (unsigned i = 0; i < 64; i++) {
+			ebr_shm_enter(ebr_shm, slot);
+			access_obj(&ds[(n + i) & (DS_COUNT - 1)]);
+			ebr_shm_exit(ebr_shm, slot);
+		}
+		ebr_shm_unregister(ebr_shm, slot);
+	}
+	pthread_barrier_wait(&barrier);
+	if (id == 0) {
+		ebr_shm_unregister(ebr_shm, slot);
+	}
+	pthread_exit(NULL);
+	return NULL;
+}
+
 /*
  * QSBR stress test.
  */
@@ -226,6 +400,13 @@ qsbr_stress(void *arg)
 			continue;
 		}
 		access_obj(&ds[n]);
+
+		/* Some of the readers occasionally go offline. */
+		if ((id & 1) && n == 0) {
+			qsbr_thread_offline(qsbr);
+			qsbr_thread_online(qsbr);
+			access_obj(&ds[n]);
+		}
 		qsbr_checkpoint(qsbr);
 	}
 	pthread_barrier_wait(&barrier);
@@ -234,6 +415,219 @@ qsbr_stress(void *arg)
 	return NULL;
 }
 
+static void *
+qsbr_h_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	qsbr_tls_t *t;
+
+	/*
+	 * As qsbr_stress(), but using the handle-based routines.
+	 */
+
+	t = qsbr_register_h(qsbr);
+	assert(t != NULL);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			qsbr_writer(n);
+			continue;
+		}
+		access_obj(&ds[n]);
+
+		/* Some of the readers occasionally go offline. */
+		if ((id & 1) && n == 0) {
+			qsbr_thread_offline_h(qsbr, t);
+			qsbr_thread_online_h(qsbr, t);
+			access_obj(&ds[n]);
+		}
+		qsbr_checkpoint_h(qsbr, t);
+	}
+	pthread_barrier_wait(&barrier);
+	qsbr_unregister(qsbr);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * QSBR deferred callbacks stress test.
+ */
+
+static void
+qsbr_defer_func(void *arg)
+{
+	mock_destroy_obj(arg);
+}
+
+static void
+qsbr_defer_writer(unsigned target)
+{
+	data_struct_t *obj = &ds[target];
+
+	if (obj->visible) {
+		mock_remove_obj(obj);
+		if (qsbr_defer(qsbr, qsbr_defer_func, obj) == -1) {
+			abort();
+		}
+	} else if (!obj->ptr) {
+		mock_insert_obj(obj);
+	}
+}
+
+static void *
+qsbr_defer_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	qsbr_tls_t *t;
+
+	t = qsbr_register_h(qsbr);
+	assert(t != NULL);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			qsbr_defer_writer(n);
+		} else {
+			access_obj(&ds[n]);
+		}
+		/* Note: runs the deferred callbacks. */
+		qsbr_checkpoint_h(qsbr, t);
+	}
+	pthread_barrier_wait(&barrier);
+	qsbr_unregister(qsbr);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * Hazard pointers stress test.
+ */
+
+static void
+hp_writer(unsigned target)
+{
+	data_struct_t *obj = &ds[target];
+
+	if (ds_ptrs[target]) {
+		atomic_store_explicit(&ds_ptrs[target], NULL,
+		    memory_order_relaxed);
+		mock_remove_obj(obj);
+		hp_retire(hp, obj);
+	} else if (!obj->ptr) {
+		mock_insert_obj(obj);
+		atomic_store_explicit(&ds_ptrs[target], obj,
+		    memory_order_release);
+	}
+	hp_scan(hp);
+}
+
+static void *
+hp_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	hp_tls_t *t;
+
+	t = hp_register_h(hp);
+	assert(t != NULL);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		data_struct_t *obj;
+
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			hp_writer(n);
+			continue;
+		}
+
+		/*
+		 * Reader: protect the object and dereference it; the
+		 * writer must not have "destroyed" it.
+		 */
+		obj = hp_protect_h(hp, t, 0, (void **)&ds_ptrs[n]);
+		if (obj && *obj->ptr != MAGIC_VAL) {
+			abort();
+		}
+		hp_clear_h(hp, t, 0);
+	}
+	pthread_barrier_wait(&barrier);
+	hp_unregister(hp);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * IBR stress test.
+ */
+
+static void
+ibr_func(gc_entry_t *entry, void *arg)
+{
+	const unsigned off = offsetof(data_struct_t, ibr_entry);
+
+	while (entry) {
+		data_struct_t *obj;
+
+		obj = (void *)((uintptr_t)entry - off);
+		entry = entry->next;
+		mock_destroy_obj(obj);
+	}
+	(void)arg;
+}
+
+static void
+ibr_writer(unsigned target)
+{
+	data_struct_t *obj = &ds[target];
+
+	if (ds_ptrs[target]) {
+		atomic_store_explicit(&ds_ptrs[target], NULL,
+		    memory_order_relaxed);
+		mock_remove_obj(obj);
+		ibr_limbo(ibr, obj);
+	} else if (!obj->ptr) {
+		ibr_birth(ibr, obj);
+		mock_insert_obj(obj);
+		atomic_store_explicit(&ds_ptrs[target], obj,
+		    memory_order_release);
+	}
+	ibr_cycle(ibr);
+}
+
+static void *
+ibr_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+	ibr_tls_t *t;
+
+	t = ibr_register_h(ibr);
+	assert(t != NULL);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		data_struct_t *obj;
+
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			ibr_writer(n);
+			continue;
+		}
+		ibr_enter_h(ibr, t);
+		obj = ibr_read_h(ibr, t, (void **)&ds_ptrs[n]);
+		if (obj && *obj->ptr != MAGIC_VAL) {
+			abort();
+		}
+		ibr_exit_h(ibr, t);
+	}
+	pthread_barrier_wait(&barrier);
+	ibr_unregister(ibr);
+	pthread_exit(NULL);
+	return NULL;
+}
+
 /*
  * G/C stress test.
  */
@@ -283,11 +677,18 @@ gc_stress(void *arg)
 		n = (n + 1) & (DS_COUNT - 1);
 		if (id == 0) {
 			gc_writer(n);
-			continue;
+		} else {
+			gc_crit_enter(gc);
+			access_obj(&ds[n]);
+			gc_crit_exit(gc);
+
+			/* Some readers also drive the G/C concurrently. */
+			if ((id & 1) && n == 0) {
+				gc_cycle(gc);
+			}
 		}
-		gc_crit_enter(gc);
-		access_obj(&ds[n]);
-		gc_crit_exit(gc);
+		/* Note: no-op unless in the QSBR mode. */
+		gc_checkpoint(gc);
 	}
 	pthread_barrier_wait(&barrier);
 	gc_unregister(gc);
@@ -295,6 +696,31 @@ gc_stress(void *arg)
 	return NULL;
 }
 
+/*
+ * G/C worker stress test: one thread keeps restarting the background
+ * worker while the writer stages the objects and wakes it up; the rest
+ * is as in gc_stress().
+ */
+static void *
+gc_worker_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+
+	if (id != 1) {
+		return gc_stress(arg);
+	}
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		if (gc_start_worker(gc, 1) == -1) {
+			err(EXIT_FAILURE, "gc_start_worker");
+		}
+		gc_stop_worker(gc);
+	}
+	pthread_barrier_wait(&barrier);
+	pthread_exit(NULL);
+	return NULL;
+}
+
 /*
  * Helper routines
  */
@@ -306,10 +732,161 @@ ding(int sig)
 	stop = true;
 }
 
+/*
+ * G/C object pool stress test: the objects are allocated with gc_alloc()
+ * and the reclaimed objects are recycled.
+ */
+
+static void
+gc_pool_func(gc_entry_t *entry, void *arg)
+{
+	const unsigned off = offsetof(data_struct_t, gc_entry);
+
+	while (entry) {
+		data_struct_t *obj;
+
+		obj = (void *)((uintptr_t)entry - off);
+		entry = entry->next;
+		mock_destroy_obj(obj);
+		gc_free(gc, obj);
+	}
+	(void)arg;
+}
+
+static void
+gc_pool_writer(unsigned target)
+{
+	data_struct_t *obj;
+
+	if ((obj = ds_ptrs[target]) != NULL) {
+		atomic_store_explicit(&ds_ptrs[target], NULL,
+		    memory_order_relaxed);
+		mock_remove_obj(obj);
+		gc_limbo(gc, obj);
+	} else {
+		if ((obj = gc_alloc(gc, sizeof(data_struct_t))) == NULL) {
+			err(EXIT_FAILURE, "gc_alloc");
+		}
+		memset(obj, 0, sizeof(data_struct_t));
+		mock_insert_obj(obj);
+		atomic_store_explicit(&ds_ptrs[target], obj,
+		    memory_order_release);
+	}
+	gc_cycle(gc);
+}
+
+static void *
+gc_pool_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+
+	gc_register(gc);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n = (n + 1) & (DS_COUNT - 1);
+		if (id == 0) {
+			gc_pool_writer(n);
+		} else {
+			data_struct_t *obj;
+
+			gc_crit_enter(gc);
+			obj = atomic_load_explicit(&ds_ptrs[n],
+			    memory_order_acquire);
+			if (obj) {
+				access_obj(obj);
+			}
+			gc_crit_exit(gc);
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	gc_unregister(gc);
+	pthread_exit(NULL);
+	return NULL;
+}
+
+/*
+ * Hash table stress test: the writer inserts, replaces and removes the
+ * values, which are destroyed once reclaimed; the table also grows.
+ */
+
+#define	HT_KEYS			4096
+
+static void
+ht_valfree(void *val, void *arg)
+{
+	data_struct_t *obj = val;
+
+	mock_destroy_obj(obj);
+	free(obj);
+	(void)arg;
+}
+
+static void
+ht_writer(unsigned n)
+{
+	static bool present[HT_KEYS];
+	const unsigned key = n % HT_KEYS;
+	data_struct_t *obj;
+
+	/*
+	 * Alternate the rounds of the removals and the replacements.
+	 */
+	if (present[key] && ((n / HT_KEYS) & 1) == 0) {
+		ht_del(ht, key);
+		present[key] = false;
+	} else {
+		if ((obj = calloc(1, sizeof(data_struct_t))) == NULL) {
+			err(EXIT_FAILURE, "calloc");
+		}
+		mock_insert_obj(obj);
+		if (ht_put(ht, key, obj) == -1) {
+			err(EXIT_FAILURE, "ht_put");
+		}
+		present[key] = true;
+	}
+	gc_cycle(ht_gc(ht));
+}
+
+static void *
+ht_stress(void *arg)
+{
+	const unsigned id = (uintptr_t)arg;
+	unsigned n = 0;
+
+	ht_register(ht);
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		n++;
+		if (id == 0) {
+			ht_writer(n);
+		} else {
+			data_struct_t *obj;
+
+			ht_enter(ht);
+			if ((obj = ht_get(ht, n % HT_KEYS)) != NULL) {
+				access_obj(obj);
+			}
+			ht_exit(ht);
+
+			/* Some readers also drive the G/C concurrently. */
+			if ((id & 1) && (n % HT_KEYS) == 0) {
+				gc_cycle(ht_gc(ht));
+			}
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	ht_unregister(ht);
+	pthread_exit(NULL);
+	return NULL;
+}
+
 static void
 run_test(void *func(void *))
 {
 	struct sigaction sigalarm;
+	size_t shm_len;
+	void *shm_mem;
 	pthread_t *thr;
 	int ret;
 
@@ -330,9 +907,29 @@ run_test(void *func(void *))
 	 * Create some data structures and the EBR object.
 	 */
 	memset(&ds, 0, sizeof(ds));
-	ebr = ebr_create();
+	memset(&ds_ptrs, 0, sizeof(ds_ptrs));
+	ebr = ebr_create_ex(ebr_flags);
+
+	/*
+	 * Note: the process-shared EBR has the spare slots, which the
+	 * exiting child processes can claim.
+	 */
+	shm_len = ebr_shm_size(nworkers * 2);
+	shm_mem = mmap(NULL, shm_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shm_mem == MAP_FAILED) {
+		err(EXIT_FAILURE, "mmap");
+	}
+	ebr_shm = ebr_shm_init(shm_mem, shm_len, nworkers * 2);
 	qsbr = qsbr_create();
-	gc = gc_create(offsetof(data_struct_t, gc_entry), gc_func, NULL);
+	gc = gc_create_ex(offsetof(data_struct_t, gc_entry),
+	    (gc_flags & GC_POOL) ? gc_pool_func : gc_func, NULL, gc_flags);
+	if (gc_helpers && gc_start_helpers(gc, gc_helpers, 1) == -1) {
+		err(EXIT_FAILURE, "gc_start_helpers");
+	}
+	hp = hp_create(1, offsetof(data_struct_t, gc_entry), gc_func, NULL);
+	ibr = ibr_create(offsetof(data_struct_t, ibr_entry), ibr_func, NULL);
+	ht = ht_create(0, 0, ht_valfree, NULL);
 	destructions = 0;
 
 	/*
@@ -353,9 +950,18 @@ run_test(void *func(void *))
 	printf("# %"PRIu64"\n", destructions);
 
 	ebr_destroy(ebr);
+	munmap(shm_mem, shm_len);
 	qsbr_destroy(qsbr);
+	hp_destroy(hp);
+	ibr_destroy(ibr);
+	ht_destroy(ht);
 
 	gc_full(gc, 1);
+	for (unsigned i = 0; i < DS_COUNT && (gc_flags & GC_POOL); i++) {
+		if (ds_ptrs[i]) {
+			gc_free(gc, ds_ptrs[i]);
+		}
+	}
 	gc_destroy(gc);
 }
 
@@ -367,8 +973,32 @@ main(int argc, char **argv)
 	}
 	puts("stress test");
 	run_test(ebr_stress);
+	run_test(ebr_h_stress);
+	ebr_flags = EBR_MEMBARRIER;
+	run_test(ebr_stress);
+	ebr_flags = EBR_HIERARCHICAL;
+	run_test(ebr_stress);
+	run_test(ebr_h_stress);
+	ebr_flags = 0;
+	run_test(ebr_shm_stress);
+	run_test(ebr_shm_reap_stress);
 	run_test(qsbr_stress);
+	run_test(qsbr_h_stress);
+	run_test(qsbr_defer_stress);
+	run_test(gc_stress);
+	gc_flags = GC_QSBR;
+	run_test(gc_stress);
+	gc_flags = 0;
+	gc_helpers = 2;
 	run_test(gc_stress);
+	gc_helpers = 0;
+	run_test(gc_worker_stress);
+	gc_flags = GC_POOL;
+	run_test(gc_pool_stress);
+	gc_flags = 0;
+	run_test(hp_stress);
+	run_test(ibr_stress);
+	run_test(ht_stress);
 	puts("ok");
 	return 0;
 }
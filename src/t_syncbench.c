@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016-2018 Mindaugas Rasiukevicius <rmind at noxt eu>
+ * All rights reserved.
+ *
+ * Use is subject to license terms, as specified in the LICENSE file.
+ */
+
+/*
+ * Benchmark of the EBR synchronisation cost against the number of the
+ * registered threads, comparing the flat and the hierarchical modes.
+ *
+ * Usage: t_syncbench [max-threads [msec]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <err.h>
+
+#include "ebr.h"
+#include "utils.h"
+
+static pthread_barrier_t	barrier;
+static ebr_t *			ebr;
+static volatile bool		stop;
+static uint64_t			reader_ops;
+
+static void *
+reader(void *arg)
+{
+	ebr_tls_t *t;
+	uint64_t n = 0;
+
+	(void)arg;
+	if ((t = ebr_register_h(ebr)) == NULL) {
+		err(EXIT_FAILURE, "ebr_register_h");
+	}
+	pthread_barrier_wait(&barrier);
+	while (!stop) {
+		ebr_enter_h(ebr, t);
+		ebr_exit_h(ebr, t);
+		n++;
+	}
+	atomic_fetch_add(&reader_ops, n);
+	pthread_barrier_wait(&barrier);
+	ebr_unregister(ebr);
+	return NULL;
+}
+
+static void
+run_bench(unsigned nthreads, unsigned flags, unsigned msec)
+{
+	const uint64_t duration = (uint64_t)msec * 1000000;
+	uint64_t start, elapsed, nsyncs = 0, nok = 0;
+	pthread_t *thr;
+
+	if ((ebr = ebr_create_ex(flags)) == NULL) {
+		err(EXIT_FAILURE, "ebr_create_ex");
+	}
+	if ((thr = calloc(nthreads, sizeof(pthread_t))) == NULL) {
+		err(EXIT_FAILURE, "calloc");
+	}
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	stop = false;
+	reader_ops = 0;
+
+	for (unsigned i = 0; i < nthreads; i++) {
+		if (pthread_create(&thr[i], NULL, reader, NULL) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+	pthread_barrier_wait(&barrier);
+
+	start = clock_nsec();
+	do {
+		for (unsigned i = 0; i < 64; i++) {
+			unsigned gc_epoch;
+			nok += ebr_sync(ebr, &gc_epoch);
+		}
+		nsyncs += 64;
+		elapsed = clock_nsec() - start;
+	} while (elapsed < duration);
+
+	stop = true;
+	pthread_barrier_wait(&barrier);
+	for (unsigned i = 0; i < nthreads; i++) {
+		pthread_join(thr[i], NULL);
+	}
+	pthread_barrier_destroy(&barrier);
+
+	printf("%-12s %8u %12.1f %10.1f%% %14.1f\n",
+	    (flags & EBR_HIERARCHICAL) ? "hierarchical" : "flat",
+	    nthreads, (double)elapsed / nsyncs, 100.0 * nok / nsyncs,
+	    (double)reader_ops * 1000 / elapsed);
+
+	ebr_destroy(ebr);
+	free(thr);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned max_threads = 64, msec = 250;
+
+	if (argc > 1) {
+		max_threads = (unsigned)atoi(argv[1]);
+	}
+	if (argc > 2) {
+		msec = (unsigned)atoi(argv[2]);
+	}
+
+	printf("%-12s %8s %12s %11s %14s\n",
+	    "mode", "threads", "ns/sync", "sync ok", "reader Mops/s");
+	for (unsigned n = 1; n <= max_threads; n *= 2) {
+		run_bench(n, 0, msec);
+		run_bench(n, EBR_HIERARCHICAL, msec);
+	}
+	return 0;
+}
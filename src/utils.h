@@ -9,6 +9,8 @@
 #define	_UTILS_H_
 
 #include <assert.h>
+#include <stdint.h>
+#include <time.h>
 
 /*
  * A regular assert (debug/diagnostic only).
@@ -27,6 +29,10 @@
 #define	__predict_false(x)	__builtin_expect((x) != 0, 0)
 #endif
 
+#ifndef __aligned
+#define	__aligned(x)		__attribute__((__aligned__(x)))
+#endif
+
 /*
  * Atomic operations and memory barriers.  If C11 API is not available,
  * then wrap the GCC builtin routines.
@@ -54,6 +60,9 @@ again:
 #ifndef atomic_fetch_add
 #define	atomic_fetch_add(x,a)	__sync_fetch_and_add(x, a)
 #endif
+#ifndef atomic_fetch_or
+#define	atomic_fetch_or(x,a)	__sync_fetch_and_or(x, a)
+#endif
 
 #ifndef atomic_thread_fence
 #define	memory_order_relaxed	__ATOMIC_RELAXED
@@ -62,6 +71,9 @@ again:
 #define	memory_order_seq_cst	__ATOMIC_SEQ_CST
 #define	atomic_thread_fence(m)	__atomic_thread_fence(m)
 #endif
+#ifndef atomic_signal_fence
+#define	atomic_signal_fence(m)	__atomic_signal_fence(m)
+#endif
 #ifndef atomic_store_explicit
 #define	atomic_store_explicit	__atomic_store_n
 #endif
@@ -88,6 +100,18 @@ do {								\
 		(count) += (count);				\
 } while (/* CONSTCOND */ 0);
 
+/*
+ * Monotonic clock in nanoseconds.
+ */
+static inline uint64_t
+clock_nsec(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 /*
  * Cache line size - a reasonable upper bound.
  */